@@ -0,0 +1,389 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+// Input generator and end-to-end benchmark for test, test2 and test3.
+//
+//   bench generate J min_side max_side seed [alternate] > input
+//   bench run J min_side max_side seed binary... [-a binary...]
+//
+// Generated games follow the input format: J, then per game "N M", the
+// placements of both fleets and the attacks. Every placement is valid and
+// the attacks stop on the shot that wins the game, so the file is read to
+// the end and never runs out. "alternate" interleaves the placements of
+// the two players the way test3 reads them; in run mode -a marks the
+// binaries that need this order.
+
+#define OUT_BUFFER_SIZE (1 << 20)
+#define PLACE_ATTEMPTS 1000
+
+typedef struct {
+    int fd;
+    char *data;
+    size_t used;
+    long long bytes;     // Total bytes written
+} Output;
+
+typedef struct {
+    long long games;
+    long long placements;
+    long long shots;
+    long long bytes;
+} GenStats;
+
+typedef struct {
+    char type;
+    char orientation;
+    int x, y;
+} Placement;
+
+typedef struct {
+    uint64_t key;
+    uint64_t counter;
+} Rng;
+
+static const char ship_types[] = "SYBLA";
+static const int ship_lengths[] = {5, 4, 3, 2, 1};
+static const int ship_divisors[] = {70, 55, 40, 30, 20};
+
+static inline uint64_t mix64(uint64_t z) {
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+static inline uint32_t rng_below(Rng *rng, uint32_t bound) {
+    uint64_t r = mix64(rng->key + 0x9E3779B97F4A7C15ULL * ++rng->counter);
+    return (uint32_t)(((r >> 32) * bound) >> 32);
+}
+
+static void flush_output(Output *out) {
+    size_t done = 0;
+    while (done < out->used) {
+        ssize_t n = write(out->fd, out->data + done, out->used - done);
+        if (n <= 0) {
+            perror("write");
+            exit(1);
+        }
+        done += (size_t)n;
+    }
+    out->used = 0;
+}
+
+static inline void put_char(Output *out, char c) {
+    if (out->used == OUT_BUFFER_SIZE) flush_output(out);
+    out->data[out->used++] = c;
+    out->bytes++;
+}
+
+static void put_int(Output *out, long long value) {
+    char digits[24];
+    int n = 0;
+    do {
+        digits[n++] = (char)('0' + value % 10);
+        value /= 10;
+    } while (value > 0);
+    while (n > 0) put_char(out, digits[--n]);
+}
+
+static void put_pair(Output *out, int a, int b) {
+    put_int(out, a);
+    put_char(out, ' ');
+    put_int(out, b);
+    put_char(out, '\n');
+}
+
+static void put_placement(Output *out, Placement *p) {
+    put_char(out, p->type);
+    put_char(out, ' ');
+    put_char(out, p->orientation);
+    put_char(out, ' ');
+    put_pair(out, p->x, p->y);
+}
+
+// Cells covered by a ship, same geometry as place_ship(): H grows to the
+// right, V grows upwards
+static int fits(unsigned char *occupied, int M, int length, char orientation, int x, int y) {
+    if (orientation == 'H') {
+        if (y + length - 1 > M) return 0;
+        for (int i = 0; i < length; i++) {
+            if (occupied[(size_t)(x - 1) * M + (y - 1 + i)]) return 0;
+        }
+    } else {
+        if (x - length + 1 < 1) return 0;
+        for (int i = 0; i < length; i++) {
+            if (occupied[(size_t)(x - 1 - i) * M + (y - 1)]) return 0;
+        }
+    }
+    return 1;
+}
+
+static void occupy(unsigned char *occupied, int M, int length, char orientation, int x, int y) {
+    for (int i = 0; i < length; i++) {
+        if (orientation == 'H') {
+            occupied[(size_t)(x - 1) * M + (y - 1 + i)] = 1;
+        } else {
+            occupied[(size_t)(x - 1 - i) * M + (y - 1)] = 1;
+        }
+    }
+}
+
+// Random fleet in placement order; heads marks the start cells.
+// Falls back to a scan of the board when random attempts keep colliding.
+static int generate_fleet(Rng *rng, int N, int M, unsigned char *occupied, unsigned char *heads, Placement *fleet) {
+    int count = 0;
+    memset(occupied, 0, (size_t)N * M);
+    memset(heads, 0, (size_t)N * M);
+
+    for (int t = 0; t < 5; t++) {
+        int quota = (int)((long long)N * M / ship_divisors[t]);
+        int length = ship_lengths[t];
+        for (int k = 0; k < quota; k++) {
+            Placement p = {ship_types[t], 'H', 0, 0};
+            int placed = 0;
+            for (int attempt = 0; attempt < PLACE_ATTEMPTS && !placed; attempt++) {
+                p.orientation = rng_below(rng, 2) ? 'V' : 'H';
+                p.x = 1 + (int)rng_below(rng, N);
+                p.y = 1 + (int)rng_below(rng, M);
+                placed = fits(occupied, M, length, p.orientation, p.x, p.y);
+            }
+            for (int x = 1; x <= N && !placed; x++) {
+                for (int y = 1; y <= M && !placed; y++) {
+                    p.x = x;
+                    p.y = y;
+                    p.orientation = 'H';
+                    placed = fits(occupied, M, length, 'H', x, y);
+                    if (!placed) {
+                        p.orientation = 'V';
+                        placed = fits(occupied, M, length, 'V', x, y);
+                    }
+                }
+            }
+            if (!placed) return -1;
+            occupy(occupied, M, length, p.orientation, p.x, p.y);
+            heads[(size_t)(p.x - 1) * M + (p.y - 1)] = 1;
+            fleet[count++] = p;
+        }
+    }
+    return count;
+}
+
+// Write one game and return 0, or -1 if a fleet does not fit
+static int generate_game(Output *out, Rng *rng, int N, int M, int alternate, GenStats *stats) {
+    size_t cells = (size_t)N * M;
+    unsigned char *occupied = (unsigned char*)malloc(cells);
+    unsigned char *heads[2];
+    Placement *fleets[2];
+    uint32_t *order[2];
+    int count[2];
+    int status = 0;
+
+    for (int p = 0; p < 2; p++) {
+        heads[p] = (unsigned char*)malloc(cells);
+        fleets[p] = (Placement*)malloc((cells / 20 + 1) * 5 * sizeof(Placement));
+        order[p] = (uint32_t*)malloc(cells * sizeof(uint32_t));
+        count[p] = generate_fleet(rng, N, M, occupied, heads[p], fleets[p]);
+        if (count[p] < 0) status = -1;
+    }
+
+    if (status == 0) {
+        put_pair(out, N, M);
+        if (alternate) {
+            for (int i = 0; i < count[0]; i++) {
+                put_placement(out, &fleets[0][i]);
+                put_placement(out, &fleets[1][i]);
+            }
+        } else {
+            for (int p = 0; p < 2; p++) {
+                for (int i = 0; i < count[p]; i++) put_placement(out, &fleets[p][i]);
+            }
+        }
+        stats->placements += count[0] + count[1];
+
+        // Each player shoots every cell once in random order. Only a hit on
+        // the start sinks a ship (the other segments never add up to its
+        // length), so the game ends once all heads of one fleet are hit.
+        for (int p = 0; p < 2; p++) {
+            for (size_t c = 0; c < cells; c++) order[p][c] = (uint32_t)c;
+        }
+        int remaining[2] = {count[1], count[0]};   // Heads left to the shooter
+        for (size_t k = 0; ; k++) {
+            int winner = -1;
+            for (int p = 0; p < 2 && winner < 0; p++) {
+                size_t j = k + rng_below(rng, (uint32_t)(cells - k));
+                uint32_t cell = order[p][j];
+                order[p][j] = order[p][k];
+                order[p][k] = cell;
+
+                put_pair(out, (int)(cell / M) + 1, (int)(cell % M) + 1);
+                stats->shots++;
+                if (heads[1 - p][cell] && --remaining[p] == 0) winner = p;
+            }
+            if (winner >= 0) break;
+        }
+        stats->games++;
+    }
+
+    free(occupied);
+    for (int p = 0; p < 2; p++) {
+        free(heads[p]);
+        free(fleets[p]);
+        free(order[p]);
+    }
+    return status;
+}
+
+// Write J games with sides in [min_side, max_side] to fd
+static int generate(int fd, long long J, int min_side, int max_side, uint64_t seed, int alternate, GenStats *stats) {
+    Output out = {fd, (char*)malloc(OUT_BUFFER_SIZE), 0, 0};
+    Rng rng = {mix64(seed), 0};
+    memset(stats, 0, sizeof(GenStats));
+
+    put_int(&out, J);
+    put_char(&out, '\n');
+    for (long long g = 0; g < J; g++) {
+        int N, M;
+        // Every game needs ships on both sides, or it would never end
+        do {
+            N = min_side + (int)rng_below(&rng, (uint32_t)(max_side - min_side + 1));
+            M = min_side + (int)rng_below(&rng, (uint32_t)(max_side - min_side + 1));
+        } while ((long long)N * M < 20);
+        if (generate_game(&out, &rng, N, M, alternate, stats) != 0) {
+            fprintf(stderr, "Eroare: flota nu încape pe tabla %dx%d.\n", N, M);
+            free(out.data);
+            return 1;
+        }
+    }
+    flush_output(&out);
+    stats->bytes = out.bytes;
+    free(out.data);
+    return 0;
+}
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// Run binary with input on stdin and stdout discarded; returns the wall time
+// and the peak resident set in KB
+static int run_binary(const char *binary, const char *input, double *seconds, long *peak_kb) {
+    double start = now_seconds();
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("fork");
+        return 1;
+    }
+    if (pid == 0) {
+        int in = open(input, O_RDONLY);
+        int null = open("/dev/null", O_WRONLY);
+        if (in < 0 || null < 0) _exit(127);
+        dup2(in, 0);
+        dup2(null, 1);
+        execl(binary, binary, (char*)NULL);
+        _exit(127);
+    }
+
+    int status;
+    struct rusage usage;
+    if (wait4(pid, &status, 0, &usage) < 0) {
+        perror("wait4");
+        return 1;
+    }
+    *seconds = now_seconds() - start;
+    *peak_kb = usage.ru_maxrss;
+    return !WIFEXITED(status) || WEXITSTATUS(status) != 0;
+}
+
+static int make_input(char *path, long long J, int min_side, int max_side, uint64_t seed, int alternate, GenStats *stats) {
+    int fd = mkstemp(path);
+    if (fd < 0) {
+        perror("mkstemp");
+        return 1;
+    }
+    int failed = generate(fd, J, min_side, max_side, seed, alternate, stats);
+    close(fd);
+    return failed;
+}
+
+int run_benchmark(long long J, int min_side, int max_side, uint64_t seed, int argc, char *argv[]) {
+    char paths[2][64] = {"/tmp/bench-seq-XXXXXX", "/tmp/bench-alt-XXXXXX"};
+    int made[2] = {0, 0};
+    GenStats stats[2];
+    int alternate = 0;
+    int failed = 0;
+
+    printf("%-16s %10s %10s %14s %10s %12s\n", "binary", "seconds", "games/s", "shots/s", "MB/s", "peak RSS KB");
+    for (int i = 0; i < argc && !failed; i++) {
+        if (strcmp(argv[i], "-a") == 0) {
+            alternate = 1;
+            continue;
+        }
+
+        // Both players place from the same seed, so the two orders hold the same games
+        if (!made[alternate]) {
+            if (make_input(paths[alternate], J, min_side, max_side, seed, alternate, &stats[alternate]) != 0) {
+                failed = 1;
+                break;
+            }
+            made[alternate] = 1;
+        }
+
+        double seconds;
+        long peak_kb;
+        GenStats *s = &stats[alternate];
+        if (run_binary(argv[i], paths[alternate], &seconds, &peak_kb) != 0) {
+            fprintf(stderr, "Eroare: %s nu a rulat corect.\n", argv[i]);
+            failed = 1;
+            break;
+        }
+        printf("%-16s %10.3f %10.0f %14.0f %10.1f %12ld\n", argv[i], seconds,
+               s->games / seconds, s->shots / seconds, s->bytes / seconds / 1e6, peak_kb);
+    }
+
+    for (int a = 0; a < 2; a++) {
+        if (made[a]) {
+            printf("input %s: %lld games, %lld placements, %lld shots, %.1f MB\n",
+                   a ? "alternate" : "sequential", stats[a].games, stats[a].placements,
+                   stats[a].shots, stats[a].bytes / 1e6);
+            unlink(paths[a]);
+        }
+    }
+    return failed;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 6 || (strcmp(argv[1], "generate") != 0 && strcmp(argv[1], "run") != 0)) {
+        fprintf(stderr, "Utilizare: %s generate J min_side max_side seed [alternate]\n", argv[0]);
+        fprintf(stderr, "           %s run J min_side max_side seed binary... [-a binary...]\n", argv[0]);
+        return 1;
+    }
+
+    long long J = atoll(argv[2]);
+    int min_side = atoi(argv[3]);
+    int max_side = atoi(argv[4]);
+    uint64_t seed = strtoull(argv[5], NULL, 10);
+    if (J < 1 || min_side < 1 || max_side < min_side || max_side < 5 || (long long)max_side * max_side > INT32_MAX) {
+        fprintf(stderr, "Eroare: parametri invalizi.\n");
+        return 1;
+    }
+
+    if (strcmp(argv[1], "generate") == 0) {
+        GenStats stats;
+        int alternate = argc > 6 && strcmp(argv[6], "alternate") == 0;
+        int failed = generate(1, J, min_side, max_side, seed, alternate, &stats);
+        fprintf(stderr, "%lld games, %lld placements, %lld shots, %lld bytes\n",
+                stats.games, stats.placements, stats.shots, stats.bytes);
+        return failed;
+    }
+
+    return run_benchmark(J, min_side, max_side, seed, argc - 6, argv + 6);
+}
@@ -60,49 +60,72 @@ void findMatrixDimensions(Triple *sparse, int x, int *maxRow, int *maxCol) {
     }
 }
 
+int compareTriples(const void *a, const void *b) {
+    const Triple *t1 = a, *t2 = b;
+    if (t1->row != t2->row) return (t1->row > t2->row) - (t1->row < t2->row);
+    return (t1->col > t2->col) - (t1->col < t2->col);
+}
+
+// Sort by (row, col) so attacks can binary search the triples
+void sortSparseMatrix(Triple *sparse, int x) {
+    qsort(sparse, x, sizeof(Triple), compareTriples);
+}
+
+int findTriple(Triple *sparse, int x, int row, int col) {
+    int lo = 0, hi = x - 1;
+    while (lo <= hi) {
+        int mid = (lo + hi) / 2;
+        if (sparse[mid].row == row && sparse[mid].col == col) return mid;
+        if (sparse[mid].row < row || (sparse[mid].row == row && sparse[mid].col < col)) lo = mid + 1;
+        else hi = mid - 1;
+    }
+    return -1;
+}
+
+// Expects a sorted matrix; walks the triples alongside the grid instead of
+// building a dense copy
 void printBothRepresentations(Triple *sparse, int x) {
     printSparseMatrix(sparse, x);
     
     int maxRow, maxCol;
     findMatrixDimensions(sparse, x, &maxRow, &maxCol);
     
-    int **dense = malloc((maxRow + 1) * sizeof(int*));
-    if (!dense) {
-        printf("Memory allocation failed for dense matrix.\n");
-        return;
-    }
-    
-    for (int i = 0; i <= maxRow; i++) {
-        dense[i] = calloc(maxCol + 1, sizeof(int));
-        if (!dense[i]) {
-            printf("Memory allocation failed for dense matrix row.\n");
-            for (int j = 0; j < i; j++) {
-                free(dense[j]);
-            }
-            free(dense);
-            return;
-        }
-    }
-    
-    for (int i = 0; i < x; i++) {
-        dense[sparse[i].row][sparse[i].col] = sparse[i].value;
-    }
-    
     printf("\nDense matrix representation:\n");
+    int k = 0;
     for (int i = 0; i <= maxRow; i++) {
         for (int j = 0; j <= maxCol; j++) {
-            printf("%3d ", dense[i][j]);
+            int value = 0;
+            if (k < x && sparse[k].row == i && sparse[k].col == j) {
+                value = sparse[k++].value;
+            }
+            printf("%3d ", value);
         }
         printf("\n");
     }
-    
-    for (int i = 0; i <= maxRow; i++) {
-        free(dense[i]);
+}
+
+// Returns true if (row, col) hits an active cell. Hitting the head sinks
+// the whole ship at once.
+bool attackPosition(Triple* sparse, int x, int row, int col){
+    int i = findTriple(sparse, x, row, col);
+    if (i < 0 || !sparse[i].active) {
+        return 0;
+    }
+    if (sparse[i].head) {
+        for (int j = 0; j < x; j++) {
+            sparse[j].active = 0;
+        }
+    } else {
+        sparse[i].active = 0;
     }
-    free(dense);
+    return 1;
 }
-bool attackPosition(Triple* sparse, int x, int y){
-   return 0; 
+
+bool shipDestroyed(Triple *sparse, int x) {
+    for (int i = 0; i < x; i++) {
+        if (sparse[i].active) return 0;
+    }
+    return 1;
 }
 
 int main() {
@@ -116,9 +139,17 @@ int main() {
         return 1;
     }
     
+    sortSparseMatrix(sparse, x);
     printBothRepresentations(sparse, x);
     
+    printf("\nEnter attacks: row col\n");
+    while (!shipDestroyed(sparse, x) && scanf("%d %d", &row, &col) == 2) {
+        printf("%s\n", attackPosition(sparse, x, row, col) ? "Hit!" : "Miss.");
+    }
+    if (shipDestroyed(sparse, x)) {
+        printf("Ship destroyed.\n");
+    }
+    
     free(sparse);
     return 0;
 }
-
@@ -0,0 +1,223 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// Reader for the shared memory spectator feed of test2 (test2 --feed NAME).
+//
+//   spectator NAME [interval_ms]   render both boards whenever they change
+//   spectator NAME --validate      read snapshots as fast as possible and
+//                                  check that every one is consistent
+//
+// The reader never writes to the segment and never blocks the game: it
+// copies a snapshot and retries if the sequence counter moved meanwhile.
+
+#define FEED_MAGIC 0x44454546u  // "FEED"
+#define FEED_LENGTH 0x07        // Cell byte: ship length, 0 for water
+#define FEED_HIT    0x08        // Cell byte: cell was shot
+
+#define PHASE_PLACEMENT 0
+#define PHASE_ATTACK    1
+#define PHASE_FINISHED  2
+
+// Segment header, followed by two boards of capacity cells each.
+// Keep in sync with test2.c.
+typedef struct {
+    uint32_t magic;
+    uint32_t capacity;
+    _Atomic uint64_t seq;
+    int32_t game;
+    int32_t N, M;
+    int32_t phase;
+    int32_t current_player;
+    int32_t winner;
+    int32_t ships_remaining[2];
+    int32_t closed;
+    int64_t shots;
+} FeedHeader;
+
+typedef struct {
+    int fd;
+    FeedHeader *header;
+    size_t size;
+} FeedReader;
+
+// Consistent copy of the segment
+typedef struct {
+    uint64_t seq;
+    FeedHeader header;         // seq field unused
+    unsigned char *cells;      // 2 * N * M, board of player 1 first
+    size_t cell_capacity;
+} Snapshot;
+
+static int map_feed(FeedReader *reader, size_t size) {
+    void *memory = mmap(NULL, size, PROT_READ, MAP_SHARED, reader->fd, 0);
+    if (memory == MAP_FAILED) return 0;
+    if (reader->header) munmap(reader->header, reader->size);
+    reader->header = (FeedHeader*)memory;
+    reader->size = size;
+    return 1;
+}
+
+static int open_feed(FeedReader *reader, const char *name) {
+    char path[64];
+    snprintf(path, sizeof(path), "/%s", name[0] == '/' ? name + 1 : name);
+    reader->header = NULL;
+    reader->fd = shm_open(path, O_RDONLY, 0);
+    if (reader->fd < 0) return 0;
+    if (!map_feed(reader, sizeof(FeedHeader))) return 0;
+    return reader->header->magic == FEED_MAGIC;
+}
+
+// Copy the segment under the sequence lock; returns 0 on a torn read
+static int try_snapshot(FeedReader *reader, Snapshot *snap) {
+    FeedHeader *header = reader->header;
+    uint64_t seq = atomic_load_explicit(&header->seq, memory_order_acquire);
+    if (seq & 1) return 0;
+
+    // Follow the writer when the segment grew
+    uint32_t capacity = header->capacity;
+    size_t size = sizeof(FeedHeader) + 2 * (size_t)capacity;
+    if (size > reader->size) {
+        if (!map_feed(reader, size)) return 0;
+        header = reader->header;
+    }
+
+    memcpy(&snap->header, header, sizeof(FeedHeader));
+    size_t cells = (size_t)snap->header.N * snap->header.M;
+    if (cells > capacity) return 0;
+    if (2 * cells > snap->cell_capacity) {
+        snap->cell_capacity = 2 * cells;
+        snap->cells = (unsigned char*)realloc(snap->cells, snap->cell_capacity);
+    }
+
+    unsigned char *boards = (unsigned char*)header + sizeof(FeedHeader);
+    memcpy(snap->cells, boards, cells);
+    memcpy(snap->cells + cells, boards + capacity, cells);
+
+    atomic_thread_fence(memory_order_acquire);
+    if (atomic_load_explicit(&header->seq, memory_order_relaxed) != seq) return 0;
+    snap->seq = seq;
+    return 1;
+}
+
+static char cell_char(unsigned char cell) {
+    int length = cell & FEED_LENGTH;
+    if (cell & FEED_HIT) return length ? 'X' : 'o';
+    return length ? (char)('0' + length) : '.';
+}
+
+static void render(Snapshot *snap) {
+    FeedHeader *h = &snap->header;
+    static const char *phases[] = {"plasare", "atac", "terminat"};
+
+    printf("Joc %d, %dx%d, %s, %lld lovituri, nave rămase %d / %d",
+           h->game, h->N, h->M, (h->phase >= 0 && h->phase <= 2) ? phases[h->phase] : "?",
+           (long long)h->shots, h->ships_remaining[0], h->ships_remaining[1]);
+    if (h->phase == PHASE_FINISHED) printf(", câștigă jucătorul %d", h->winner);
+    printf("\n");
+
+    size_t cells = (size_t)h->N * h->M;
+    for (int i = 0; i < h->N; i++) {
+        for (int p = 0; p < 2; p++) {
+            for (int j = 0; j < h->M; j++) {
+                putchar(cell_char(snap->cells[p * cells + (size_t)i * h->M + j]));
+            }
+            printf(p == 0 ? "   " : "\n");
+        }
+    }
+    printf("\n");
+    fflush(stdout);
+}
+
+// Check a snapshot on its own and against the previous one of the same game
+static int check_snapshot(Snapshot *snap, Snapshot *prev, int have_prev) {
+    FeedHeader *h = &snap->header;
+    size_t cells = (size_t)h->N * h->M;
+    int errors = 0;
+
+    if (h->phase < PHASE_PLACEMENT || h->phase > PHASE_FINISHED) errors++;
+    if (h->ships_remaining[0] < 0 || h->ships_remaining[1] < 0) errors++;
+    for (size_t c = 0; c < 2 * cells; c++) {
+        if ((snap->cells[c] & ~(FEED_LENGTH | FEED_HIT)) || (snap->cells[c] & FEED_LENGTH) > 5) errors++;
+    }
+
+    FeedHeader *p = &prev->header;
+    if (have_prev && p->game == h->game && p->N == h->N && p->M == h->M) {
+        if (h->phase < p->phase || h->shots < p->shots) errors++;
+        if (p->phase != PHASE_PLACEMENT &&
+            (h->ships_remaining[0] > p->ships_remaining[0] || h->ships_remaining[1] > p->ships_remaining[1])) {
+            errors++;
+        }
+        for (size_t c = 0; c < 2 * cells; c++) {
+            // Hits never go away, ships never move once placed
+            if ((prev->cells[c] & FEED_HIT) && !(snap->cells[c] & FEED_HIT)) errors++;
+            if ((prev->cells[c] & FEED_LENGTH) && (prev->cells[c] & FEED_LENGTH) != (snap->cells[c] & FEED_LENGTH)) {
+                errors++;
+            }
+        }
+    } else if (have_prev && h->game < p->game) {
+        errors++;
+    }
+    return errors;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 2) {
+        fprintf(stderr, "Utilizare: %s NUME [interval_ms | --validate]\n", argv[0]);
+        return 1;
+    }
+    int validate = argc > 2 && strcmp(argv[2], "--validate") == 0;
+    long interval_ms = (argc > 2 && !validate) ? atol(argv[2]) : 100;
+
+    FeedReader reader;
+    if (!open_feed(&reader, argv[1])) {
+        fprintf(stderr, "Eroare: fluxul %s nu există.\n", argv[1]);
+        return 1;
+    }
+
+    Snapshot snaps[2];
+    memset(snaps, 0, sizeof(snaps));
+    int current = 0;
+    int have_prev = 0;
+    long long taken = 0, torn = 0, errors = 0, games = 0;
+    uint64_t last_seq = UINT64_MAX;
+    struct timespec pause = {interval_ms / 1000, (interval_ms % 1000) * 1000000L};
+
+    for (;;) {
+        Snapshot *snap = &snaps[current];
+        if (!try_snapshot(&reader, snap)) {
+            torn++;
+            continue;
+        }
+
+        if (snap->seq != last_seq) {
+            last_seq = snap->seq;
+            taken++;
+            if (validate) {
+                Snapshot *prev = &snaps[1 - current];
+                if (!have_prev || prev->header.game != snap->header.game) games++;
+                errors += check_snapshot(snap, prev, have_prev);
+                have_prev = 1;
+                current = 1 - current;
+            } else {
+                render(snap);
+            }
+        }
+        if (snap->header.closed) break;
+        if (!validate) nanosleep(&pause, NULL);
+    }
+
+    if (validate) {
+        printf("%lld instantanee, %lld citiri reluate, %lld jocuri, %lld erori\n", taken, torn, games, errors);
+    }
+    free(snaps[0].cells);
+    free(snaps[1].cells);
+    return errors != 0;
+}
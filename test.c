@@ -2,63 +2,107 @@
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
+#include <limits.h>
+
+// Coordinates, cell counts and ship counts are 64-bit so that giant sparse
+// boards work; memory only grows with the fleet, never with N * M.
+
+// Boards with more cells than this are not printed cell by cell
+#define MAX_PRINT_CELLS (1LL << 26)
 
 // Structure for ship
 typedef struct {
     char type;
     int length;
-    int start_x, start_y;
+    long long start_x, start_y;
     char orientation;
     int *hits;  
     int total_hits;
     int destroyed;
 } Ship;
 
-// Structure for cell in sparse matrix
-typedef struct CellNode {
-    int x, y;
-    int ship_index;  
-    struct CellNode *next;
-} CellNode;
+// Slot of the open addressing cell table used while ships are placed
+typedef struct {
+    long long x, y;         // x = 0 marks an empty slot
+    long long ship_index;
+} CellSlot;
 
 // Structure for player board
 typedef struct {
-    int N, M;
-    int ship_count;
+    long long N, M;
+    long long ship_count;
     Ship *ships;
-    CellNode **board;  
-    int *row_sizes;    // Sizes of each row's linked list
-    int ships_remaining;
+    CellSlot *cells;        // Ship cells by (x, y), NULL once finalized
+    long long cell_slots;   // Table size, a power of two
+    long long cell_count;
+    long long ships_remaining;
+    int silent;             // Skip the hit messages, for abandoned games
+    
+    // Compressed sparse row layout over the occupied rows only, built by
+    // finalize_board() once placement is done. Row row_ids[r] occupies
+    // [row_ptr[r], row_ptr[r + 1]) of the cell arrays.
+    long long row_count;
+    long long *row_ids;     // Sorted row numbers that hold a ship cell
+    long long *row_ptr;
+    long long *cols;        // Column of each cell, sorted within a row
+    long long *cell_ship;   // Ship index of each cell
+    unsigned char *hit_bits; // One bit per cell, set when the cell is hit
 } PlayerBoard;
 
 // Function prototypes
-PlayerBoard* create_board(int N, int M, int ship_count);
+PlayerBoard* create_board(long long N, long long M, long long ship_count);
 void destroy_board(PlayerBoard *board);
-int place_ship(PlayerBoard *board, char type, char orientation, int x, int y, int ship_index);
-int is_valid_placement(PlayerBoard *board, char type, char orientation, int x, int y);
+int place_ship(PlayerBoard *board, char type, char orientation, long long x, long long y, long long ship_index);
+int is_valid_placement(PlayerBoard *board, char type, char orientation, long long x, long long y);
 void print_board(PlayerBoard *board);
-int attack(PlayerBoard *board, int x, int y, int player_num);
+void finalize_board(PlayerBoard *board);
+int attack(PlayerBoard *board, long long x, long long y, int player_num);
 int get_ship_length(char type);
 char* get_ship_name(char type);
+long long calculate_ships_per_type(long long N, long long M, char type);
+
+// Calculate number of ships for a given type, 0 if N * M overflows
+long long calculate_ships_per_type(long long N, long long M, char type) {
+    if (N < 1 || M < 1 || N > LLONG_MAX / M) return 0;
+    switch (type) {
+        case 'S': return (N * M) / 70;  // Shinano
+        case 'Y': return (N * M) / 55;  // Yamato
+        case 'B': return (N * M) / 40;  // Belfast
+        case 'L': return (N * M) / 30;  // Laffey
+        case 'A': return (N * M) / 20;  // Albacore
+        default: return 0;
+    }
+}
 
 // Create a new board with sparse matrix representation
-PlayerBoard* create_board(int N, int M, int ship_count) {
+PlayerBoard* create_board(long long N, long long M, long long ship_count) {
     PlayerBoard *board = (PlayerBoard*)malloc(sizeof(PlayerBoard));
     board->N = N;
     board->M = M;
     board->ship_count = ship_count;
     board->ships_remaining = ship_count;
+    board->silent = 0;
     
     // Allocate ships array
-    board->ships = (Ship*)malloc(ship_count * sizeof(Ship));
-    
-    // Allocate sparse matrix (array of linked lists for each row)
-    board->board = (CellNode**)malloc((N + 1) * sizeof(CellNode*));
-    board->row_sizes = (int*)calloc((N + 1), sizeof(int));
+    board->ships = (Ship*)malloc((ship_count + 1) * sizeof(Ship));
     
-    for (int i = 1; i <= N; i++) {
-        board->board[i] = NULL;
+    // Cell table sized for the quota fleet at under 3/4 load
+    static const char types[] = "SYBLA";
+    long long cells = 0;
+    for (int i = 0; i < 5; i++) {
+        cells += calculate_ships_per_type(N, M, types[i]) * get_ship_length(types[i]);
     }
+    board->cell_slots = 16;
+    while (board->cell_slots * 3 < cells * 4) board->cell_slots *= 2;
+    board->cells = (CellSlot*)calloc(board->cell_slots, sizeof(CellSlot));
+    board->cell_count = 0;
+    
+    board->row_count = 0;
+    board->row_ids = NULL;
+    board->row_ptr = NULL;
+    board->cols = NULL;
+    board->cell_ship = NULL;
+    board->hit_bits = NULL;
     
     return board;
 }
@@ -68,24 +112,22 @@ void destroy_board(PlayerBoard *board) {
     if (!board) return;
     
     // Free ships
-    for (int i = 0; i < board->ship_count; i++) {
+    for (long long i = 0; i < board->ship_count; i++) {
         if (board->ships[i].hits) {
             free(board->ships[i].hits);
         }
     }
     free(board->ships);
     
-    // Free sparse matrix
-    for (int i = 1; i <= board->N; i++) {
-        CellNode *current = board->board[i];
-        while (current) {
-            CellNode *temp = current;
-            current = current->next;
-            free(temp);
-        }
-    }
-    free(board->board);
-    free(board->row_sizes);
+    // Free cell table
+    free(board->cells);
+    
+    // Free compressed layout
+    free(board->row_ids);
+    free(board->row_ptr);
+    free(board->cols);
+    free(board->cell_ship);
+    free(board->hit_bits);
     free(board);
 }
 
@@ -113,8 +155,51 @@ char* get_ship_name(char type) {
     }
 }
 
+static unsigned long long hash_cell(long long x, long long y) {
+    unsigned long long h = (unsigned long long)x * 0x9E3779B97F4A7C15ULL ^ (unsigned long long)y;
+    h = (h ^ (h >> 31)) * 0xBF58476D1CE4E5B9ULL;
+    return h ^ (h >> 29);
+}
+
+// Slot of (x, y) in the cell table: the cell itself or the empty slot
+// where it would go
+static CellSlot* find_slot(PlayerBoard *board, long long x, long long y) {
+    unsigned long long mask = (unsigned long long)board->cell_slots - 1;
+    unsigned long long i = hash_cell(x, y) & mask;
+    while (board->cells[i].x != 0 && (board->cells[i].x != x || board->cells[i].y != y)) {
+        i = (i + 1) & mask;
+    }
+    return &board->cells[i];
+}
+
+// Ship index at (x, y) while placing, -1 for water
+static long long placed_ship_at(PlayerBoard *board, long long x, long long y) {
+    CellSlot *slot = find_slot(board, x, y);
+    return slot->x ? slot->ship_index : -1;
+}
+
+static void add_cell(PlayerBoard *board, long long x, long long y, long long ship_index) {
+    // Keep the load under 3/4
+    if ((board->cell_count + 1) * 4 > board->cell_slots * 3) {
+        CellSlot *old = board->cells;
+        long long old_slots = board->cell_slots;
+        board->cell_slots *= 2;
+        board->cells = (CellSlot*)calloc(board->cell_slots, sizeof(CellSlot));
+        for (long long i = 0; i < old_slots; i++) {
+            if (old[i].x) *find_slot(board, old[i].x, old[i].y) = old[i];
+        }
+        free(old);
+    }
+    
+    CellSlot *slot = find_slot(board, x, y);
+    slot->x = x;
+    slot->y = y;
+    slot->ship_index = ship_index;
+    board->cell_count++;
+}
+
 // Check if placement is valid
-int is_valid_placement(PlayerBoard *board, char type, char orientation, int x, int y) {
+int is_valid_placement(PlayerBoard *board, char type, char orientation, long long x, long long y) {
     int length = get_ship_length(type);
     if (length == 0) return 0;
     
@@ -124,17 +209,13 @@ int is_valid_placement(PlayerBoard *board, char type, char orientation, int x, i
     }
     
     if (orientation == 'H') {  // Horizontal
-        if (y + length - 1 > board->M) {
+        if (y > board->M - length + 1) {
             return 0;
         }
         // Check for collisions
         for (int i = 0; i < length; i++) {
-            CellNode *current = board->board[x];
-            while (current) {
-                if (current->y == y + i) {
-                    return 0;  // Collision
-                }
-                current = current->next;
+            if (placed_ship_at(board, x, y + i) >= 0) {
+                return 0;  // Collision
             }
         }
     } else if (orientation == 'V') {  // Vertical
@@ -143,12 +224,8 @@ int is_valid_placement(PlayerBoard *board, char type, char orientation, int x, i
         }
         // Check for collisions
         for (int i = 0; i < length; i++) {
-            CellNode *current = board->board[x - i];
-            while (current) {
-                if (current->y == y) {
-                    return 0;  // Collision
-                }
-                current = current->next;
+            if (placed_ship_at(board, x - i, y) >= 0) {
+                return 0;  // Collision
             }
         }
     } else {
@@ -159,8 +236,8 @@ int is_valid_placement(PlayerBoard *board, char type, char orientation, int x, i
 }
 
 // Place a ship on the board
-int place_ship(PlayerBoard *board, char type, char orientation, int x, int y, int ship_index) {
-    if (!is_valid_placement(board, type, orientation, x, y)) {
+int place_ship(PlayerBoard *board, char type, char orientation, long long x, long long y, long long ship_index) {
+    if (board->row_ptr || !is_valid_placement(board, type, orientation, x, y)) {
         return 0;
     }
     
@@ -176,216 +253,461 @@ int place_ship(PlayerBoard *board, char type, char orientation, int x, int y, in
     board->ships[ship_index].total_hits = 0;
     board->ships[ship_index].destroyed = 0;
     
-    // Add ship cells to sparse matrix
-    if (orientation == 'H') {
-        for (int i = 0; i < length; i++) {
-            CellNode *new_node = (CellNode*)malloc(sizeof(CellNode));
-            new_node->x = x;
-            new_node->y = y + i;
-            new_node->ship_index = ship_index;
-            new_node->next = board->board[x];
-            board->board[x] = new_node;
-            board->row_sizes[x]++;
-        }
-    } else {  // Vertical
-        for (int i = 0; i < length; i++) {
-            CellNode *new_node = (CellNode*)malloc(sizeof(CellNode));
-            new_node->x = x - i;
-            new_node->y = y;
-            new_node->ship_index = ship_index;
-            new_node->next = board->board[x - i];
-            board->board[x - i] = new_node;
-            board->row_sizes[x - i]++;
+    // Add ship cells to the cell table
+    for (int i = 0; i < length; i++) {
+        if (orientation == 'H') {
+            add_cell(board, x, y + i, ship_index);
+        } else {  // Vertical
+            add_cell(board, x - i, y, ship_index);
         }
     }
     
     return 1;
 }
 
-// Print board (for debugging/display)
-void print_board(PlayerBoard *board) {
-    // Create a temporary dense representation for printing
-    int **temp_board = (int**)malloc((board->N + 1) * sizeof(int*));
-    for (int i = 1; i <= board->N; i++) {
-        temp_board[i] = (int*)calloc((board->M + 1), sizeof(int));
-    }
-    
-    // Fill from sparse matrix
-    for (int i = 1; i <= board->N; i++) {
-        CellNode *current = board->board[i];
-        while (current) {
-            int ship_idx = current->ship_index;
-            temp_board[current->x][current->y] = board->ships[ship_idx].length;
-            current = current->next;
+static int compare_slots(const void *a, const void *b) {
+    const CellSlot *p = (const CellSlot*)a;
+    const CellSlot *q = (const CellSlot*)b;
+    if (p->x != q->x) return (p->x < q->x) ? -1 : 1;
+    if (p->y != q->y) return (p->y < q->y) ? -1 : 1;
+    return 0;
+}
+
+// Compact the cell table into CSR arrays over the occupied rows. The board
+// is read-only afterwards except for hit state, so placement must be finished.
+void finalize_board(PlayerBoard *board) {
+    if (board->row_ptr) return;
+    
+    // Pack the used slots to the front and sort them by (row, column)
+    long long cell_count = 0;
+    for (long long i = 0; i < board->cell_slots; i++) {
+        if (board->cells[i].x) board->cells[cell_count++] = board->cells[i];
+    }
+    qsort(board->cells, cell_count, sizeof(CellSlot), compare_slots);
+    
+    long long row_count = 0;
+    for (long long k = 0; k < cell_count; k++) {
+        if (k == 0 || board->cells[k].x != board->cells[k - 1].x) row_count++;
+    }
+    
+    board->row_count = row_count;
+    board->row_ids = (long long*)malloc((row_count + 1) * sizeof(long long));
+    board->row_ptr = (long long*)malloc((row_count + 1) * sizeof(long long));
+    board->cols = (long long*)malloc((cell_count + 1) * sizeof(long long));
+    board->cell_ship = (long long*)malloc((cell_count + 1) * sizeof(long long));
+    board->hit_bits = (unsigned char*)calloc(cell_count / 8 + 1, 1);
+    
+    long long row = -1;
+    for (long long k = 0; k < cell_count; k++) {
+        if (k == 0 || board->cells[k].x != board->cells[k - 1].x) {
+            row++;
+            board->row_ids[row] = board->cells[k].x;
+            board->row_ptr[row] = k;
         }
+        board->cols[k] = board->cells[k].y;
+        board->cell_ship[k] = board->cells[k].ship_index;
+    }
+    board->row_ptr[row_count] = cell_count;
+    
+    free(board->cells);
+    board->cells = NULL;
+}
+
+// Position of row x in row_ids, -1 if the row holds no ship
+static long long find_row(PlayerBoard *board, long long x) {
+    long long lo = 0;
+    long long hi = board->row_count - 1;
+    
+    while (lo <= hi) {
+        long long mid = lo + (hi - lo) / 2;
+        if (board->row_ids[mid] == x) return mid;
+        if (board->row_ids[mid] < x) lo = mid + 1;
+        else hi = mid - 1;
     }
+    return -1;
+}
+
+// Find the CSR cell at (x, y) by binary search; returns -1 if empty
+static long long find_cell(PlayerBoard *board, long long x, long long y) {
+    long long row = find_row(board, x);
+    if (row < 0) return -1;
     
-    // Print
-    for (int i = 1; i <= board->N; i++) {
-        for (int j = 1; j <= board->M; j++) {
-            printf("%d", temp_board[i][j]);
+    long long lo = board->row_ptr[row];
+    long long hi = board->row_ptr[row + 1] - 1;
+    
+    while (lo <= hi) {
+        long long mid = lo + (hi - lo) / 2;
+        if (board->cols[mid] == y) return mid;
+        if (board->cols[mid] < y) lo = mid + 1;
+        else hi = mid - 1;
+    }
+    return -1;
+}
+
+// Print board (for debugging/display). Streams the rows from the compressed
+// layout, so it needs finalize_board() first.
+void print_board(PlayerBoard *board) {
+    if (board->N > MAX_PRINT_CELLS / board->M) {
+        printf("Tabla %lldx%lld este prea mare pentru afișare (%lld celule ocupate).\n",
+               board->N, board->M, board->row_ptr ? board->row_ptr[board->row_count] : 0);
+        return;
+    }
+    
+    long long row = 0;
+    for (long long i = 1; i <= board->N; i++) {
+        // Occupied rows come in order, walk them alongside
+        long long k = 0, end = 0;
+        if (board->row_ptr && row < board->row_count && board->row_ids[row] == i) {
+            k = board->row_ptr[row];
+            end = board->row_ptr[row + 1];
+            row++;
+        }
+        
+        for (long long j = 1; j <= board->M; j++) {
+            int length = 0;
+            if (k < end && board->cols[k] == j) {
+                length = board->ships[board->cell_ship[k]].length;
+                k++;
+            }
+            printf("%d", length);
             if (j < board->M) printf(" ");
         }
         printf("\n");
     }
-    
-    // Free temporary board
-    for (int i = 1; i <= board->N; i++) {
-        free(temp_board[i]);
-    }
-    free(temp_board);
 }
 
 // Process an attack on a board
-int attack(PlayerBoard *board, int x, int y, int player_num) {
+int attack(PlayerBoard *board, long long x, long long y, int player_num) {
     // Check bounds
     if (x < 1 || x > board->N || y < 1 || y > board->M) {
         return 0;  // Miss
     }
     
+    // Finalized board: binary search over the row, hits in the bitmap
+    if (board->row_ptr) {
+        long long cell = find_cell(board, x, y);
+        if (cell < 0) {
+            return 0;  // Miss (no ship at position)
+        }
+        
+        Ship *ship = &board->ships[board->cell_ship[cell]];
+        if (ship->destroyed) {
+            return 0;  // Already destroyed, counts as miss
+        }
+        
+        // Check if this is the start coordinate
+        if (x == ship->start_x && y == ship->start_y) {
+            // Destroy entire ship immediately
+            ship->destroyed = 1;
+            board->ships_remaining--;
+            if (!board->silent) {
+                printf("Jucătorul %d a lovit o navă %s la coordonata (%lld, %lld).\n", 
+                       player_num, get_ship_name(ship->type), x, y);
+            }
+            return 2;  // Ship destroyed
+        }
+        
+        if (board->hit_bits[cell >> 3] & (1 << (cell & 7))) {
+            return 0;  // Already hit this segment, counts as miss
+        }
+        board->hit_bits[cell >> 3] |= (unsigned char)(1 << (cell & 7));
+        ship->total_hits++;
+        
+        if (!board->silent) {
+            printf("Jucătorul %d a lovit o navă %s la coordonata (%lld, %lld).\n", 
+                   player_num, get_ship_name(ship->type), x, y);
+        }
+        
+        // Check if ship is now destroyed
+        if (ship->total_hits == ship->length) {
+            ship->destroyed = 1;
+            board->ships_remaining--;
+            return 2;  // Ship destroyed
+        }
+        return 1;  // Hit but not destroyed
+    }
+    
     // Search for ship at position
-    CellNode *current = board->board[x];
-    while (current) {
-        if (current->y == y) {
-            int ship_idx = current->ship_index;
-            Ship *ship = &board->ships[ship_idx];
+    long long ship_idx = placed_ship_at(board, x, y);
+    if (ship_idx >= 0) {
+        Ship *ship = &board->ships[ship_idx];
+        
+        if (ship->destroyed) {
+            return 0;  // Already destroyed, counts as miss
+        }
+        
+        // Check if this is the start coordinate
+        if (x == ship->start_x && y == ship->start_y) {
+            // Destroy entire ship immediately
+            ship->destroyed = 1;
+            board->ships_remaining--;
+            if (!board->silent) {
+                printf("Jucătorul %d a lovit o navă %s la coordonata (%lld, %lld).\n", 
+                       player_num, get_ship_name(ship->type), x, y);
+            }
+            return 2;  // Ship destroyed
+        }
+        
+        // Calculate which segment was hit
+        long long segment = 0;
+        if (ship->orientation == 'H') {
+            segment = y - ship->start_y;
+        } else {
+            segment = ship->start_x - x;
+        }
+        
+        // Mark hit if not already hit
+        if (!ship->hits[segment]) {
+            ship->hits[segment] = 1;
+            ship->total_hits++;
             
-            if (ship->destroyed) {
-                return 0;  // Already destroyed, counts as miss
+            if (!board->silent) {
+                printf("Jucătorul %d a lovit o navă %s la coordonata (%lld, %lld).\n", 
+                       player_num, get_ship_name(ship->type), x, y);
             }
             
-            // Check if this is the start coordinate
-            if (x == ship->start_x && y == ship->start_y) {
-                // Destroy entire ship immediately
+            // Check if ship is now destroyed
+            if (ship->total_hits == ship->length) {
                 ship->destroyed = 1;
                 board->ships_remaining--;
-                printf("Jucătorul %d a lovit o navă %s la coordonata (%d, %d).\n", 
-                       player_num, get_ship_name(ship->type), x, y);
                 return 2;  // Ship destroyed
             }
-            
-            // Calculate which segment was hit
-            int segment = 0;
-            if (ship->orientation == 'H') {
-                segment = y - ship->start_y;
-            } else {
-                segment = ship->start_x - x;
-            }
-            
-            // Mark hit if not already hit
-            if (!ship->hits[segment]) {
-                ship->hits[segment] = 1;
-                ship->total_hits++;
-                
-                printf("Jucătorul %d a lovit o navă %s la coordonata (%d, %d).\n", 
-                       player_num, get_ship_name(ship->type), x, y);
-                
-                // Check if ship is now destroyed
-                if (ship->total_hits == ship->length) {
-                    ship->destroyed = 1;
-                    board->ships_remaining--;
-                    return 2;  // Ship destroyed
-                }
-                return 1;  // Hit but not destroyed
-            } else {
-                return 0;  // Already hit this segment, counts as miss
-            }
+            return 1;  // Hit but not destroyed
+        } else {
+            return 0;  // Already hit this segment, counts as miss
         }
-        current = current->next;
     }
     
     return 0;  // Miss (no ship at position)
 }
 
-int main() {
-    int J;
-    scanf("%d", &J);
+// Input goes through a small streaming tokenizer instead of scanf: scanf's
+// result was never checked, so EOF or a malformed token left the loops below
+// spinning forever. Every token remembers its byte offset, which is what the
+// error records point at.
+
+#define READ_OK        0
+#define READ_EOF       1
+#define READ_MALFORMED 2
+
+// Outcome of one game
+#define GAME_DONE      0
+#define GAME_ABANDONED 1    // Strict mode gave up on it, read on to its end
+#define GAME_STOP      2    // Nothing more can be read
+
+// Strict mode: failed attempts allowed for one ship or one shot
+#define DEFAULT_MAX_RETRIES 16
+
+typedef struct {
+    FILE *in;
+    long long offset;       // Bytes consumed so far
+    long long token_offset; // Where the last token started
+    int strict;             // Report errors and recover instead of stopping
+    int max_retries;
+    int quiet;              // Reading out an abandoned game: no reports
+    long long errors;
+} Input;
+
+static inline int next_byte(Input *input) {
+    int c = getc_unlocked(input->in);
+    if (c != EOF) input->offset++;
+    return c;
+}
+
+// Put back the byte that ended a token, so a line skip stops at its newline
+static inline void unread_byte(Input *input, int c) {
+    if (c == EOF) return;
+    ungetc(c, input->in);
+    input->offset--;
+}
+
+// Skip whitespace and return the first byte of the next token
+static int token_start(Input *input) {
+    int c = next_byte(input);
+    while (c != EOF && isspace(c)) c = next_byte(input);
+    input->token_offset = (c == EOF) ? input->offset : input->offset - 1;
+    return c;
+}
+
+static int read_number(Input *input, long long *value) {
+    int c = token_start(input);
+    if (c == EOF) return READ_EOF;
     
-    for (int game = 0; game < J; game++) {
-        int N, M;
-        scanf("%d %d", &N, &M);
-        
-        // Calculate number of ships for each type
-        int ships_per_type[5];
-        ships_per_type[0] = (N * M) / 70;  // Shinano (5)
-        ships_per_type[1] = (N * M) / 55;  // Yamato (4)
-        ships_per_type[2] = (N * M) / 40;  // Belfast (3)
-        ships_per_type[3] = (N * M) / 30;  // Laffey (2)
-        ships_per_type[4] = (N * M) / 20;  // Albacore (1)
-        
-        int total_ships = 0;
-        for (int i = 0; i < 5; i++) {
-            total_ships += ships_per_type[i];
+    int negative = (c == '-');
+    if (c == '-' || c == '+') c = next_byte(input);
+    if (c == EOF || !isdigit(c)) return READ_MALFORMED;
+    
+    long long result = 0;
+    while (c != EOF && isdigit(c)) {
+        if (result > (LLONG_MAX - (c - '0')) / 10) return READ_MALFORMED;  // Overflow
+        result = result * 10 + (c - '0');
+        c = next_byte(input);
+    }
+    if (c != EOF && !isspace(c)) return READ_MALFORMED;  // Trailing junk, as in "12x"
+    unread_byte(input, c);
+    *value = negative ? -result : result;
+    return READ_OK;
+}
+
+// A one character token such as a ship type or an orientation
+static int read_symbol(Input *input, char *value) {
+    int c = token_start(input);
+    if (c == EOF) return READ_EOF;
+    
+    int next = next_byte(input);
+    if (next != EOF && !isspace(next)) return READ_MALFORMED;
+    unread_byte(input, next);
+    *value = (char)c;
+    return READ_OK;
+}
+
+// Drop the rest of the current line so that a retry starts on a new record
+static void skip_line(Input *input) {
+    int c = next_byte(input);
+    while (c != EOF && c != '\n') c = next_byte(input);
+}
+
+// Strict mode writes one record per error to stderr and goes on; otherwise
+// the run stops with a message
+static void input_error(Input *input, int game, const char *reason) {
+    input->errors++;
+    if (input->strict) {
+        fprintf(stderr, "eroare octet=%lld joc=%d motiv=%s\n", input->token_offset, game, reason);
+    } else {
+        printf("Eroare: intrare invalidă la octetul %lld (%s).\n", input->token_offset, reason);
+    }
+}
+
+// Report a failed read. Returns 1 when strict mode recovered and the record
+// may be tried again.
+static int recover(Input *input, int game, int status) {
+    if (!input->quiet) input_error(input, game, status == READ_EOF ? "sfarsit" : "simbol");
+    if (!input->strict || status == READ_EOF) return 0;
+    skip_line(input);
+    return 1;
+}
+
+// Give up on the game: its remaining records are still read, without output,
+// so that the next game starts at its own header
+static void abandon_game(Input *input, int game, PlayerBoard *player1, PlayerBoard *player2) {
+    input_error(input, game, "reincercari");
+    input->quiet = 1;
+    player1->silent = 1;
+    player2->silent = 1;
+}
+
+// Read placements until one ship lands on the board
+static int read_placement(Input *input, int game, PlayerBoard *board, long long ship_index,
+                          PlayerBoard *player1, PlayerBoard *player2) {
+    for (int attempt = 1; ; attempt++) {
+        if (input->strict && !input->quiet && attempt > input->max_retries + 1) {
+            abandon_game(input, game, player1, player2);
         }
         
-        // Create boards for both players
-        PlayerBoard *player1 = create_board(N, M, total_ships);
-        PlayerBoard *player2 = create_board(N, M, total_ships);
+        char type, orientation;
+        long long x, y;
+        int status = read_symbol(input, &type);
+        if (status == READ_OK) status = read_symbol(input, &orientation);
+        if (status == READ_OK) status = read_number(input, &x);
+        if (status == READ_OK) status = read_number(input, &y);
         
-        // Place ships for player 1
-        char ship_types[] = {'S', 'Y', 'B', 'L', 'A'};
-        int ship_index = 0;
-        
-        for (int type_idx = 0; type_idx < 5; type_idx++) {
-            for (int i = 0; i < ships_per_type[type_idx]; i++) {
-                while (1) {
-                    char type, orientation;
-                    int x, y;
-                    scanf(" %c %c %d %d", &type, &orientation, &x, &y);
-                    
-                    if (place_ship(player1, type, orientation, x, y, ship_index)) {
-                        ship_index++;
-                        break;
-                    } else {
-                        printf("Eroare: navă invalidă. Încercați din nou.\n");
-                    }
-                }
-            }
+        if (status != READ_OK) {
+            if (recover(input, game, status)) continue;
+            return GAME_STOP;
         }
-        
-        // Place ships for player 2
-        ship_index = 0;
-        for (int type_idx = 0; type_idx < 5; type_idx++) {
-            for (int i = 0; i < ships_per_type[type_idx]; i++) {
-                while (1) {
-                    char type, orientation;
-                    int x, y;
-                    scanf(" %c %c %d %d", &type, &orientation, &x, &y);
-                    
-                    if (place_ship(player2, type, orientation, x, y, ship_index)) {
-                        ship_index++;
-                        break;
-                    } else {
-                        printf("Eroare: navă invalidă. Încercați din nou.\n");
-                    }
-                }
-            }
+        if (place_ship(board, type, orientation, x, y, ship_index)) return GAME_DONE;
+        if (!input->quiet) printf("Eroare: navă invalidă. Încercați din nou.\n");
+    }
+}
+
+static int read_fleet(Input *input, int game, PlayerBoard *board, const long long *ships_per_type,
+                      PlayerBoard *player1, PlayerBoard *player2) {
+    long long ship_index = 0;
+    for (int type_idx = 0; type_idx < 5; type_idx++) {
+        for (long long i = 0; i < ships_per_type[type_idx]; i++) {
+            int result = read_placement(input, game, board, ship_index, player1, player2);
+            if (result != GAME_DONE) return result;
+            ship_index++;
         }
+    }
+    return GAME_DONE;
+}
+
+static int play_game(Input *input, int game) {
+    long long N, M;
+    int status = read_number(input, &N);
+    if (status == READ_OK) status = read_number(input, &M);
+    
+    // Without the board size the fleet and so the end of the game are
+    // unknown: there is nothing to resync on, even in strict mode
+    if (status != READ_OK) {
+        input_error(input, game, status == READ_EOF ? "sfarsit" : "simbol");
+        return GAME_STOP;
+    }
+    if (N < 1 || M < 1 || N > LLONG_MAX / M) {
+        input_error(input, game, "dimensiuni");
+        return GAME_STOP;
+    }
+    
+    // Calculate number of ships for each type
+    char ship_types[] = {'S', 'Y', 'B', 'L', 'A'};
+    long long ships_per_type[5];
+    long long total_ships = 0;
+    for (int i = 0; i < 5; i++) {
+        ships_per_type[i] = calculate_ships_per_type(N, M, ship_types[i]);
+        total_ships += ships_per_type[i];
+    }
+    
+    // Create boards for both players
+    PlayerBoard *player1 = create_board(N, M, total_ships);
+    PlayerBoard *player2 = create_board(N, M, total_ships);
+    
+    int result = read_fleet(input, game, player1, ships_per_type, player1, player2);
+    if (result == GAME_DONE) result = read_fleet(input, game, player2, ships_per_type, player1, player2);
+    
+    if (result == GAME_DONE) {
+        // Placement is over, switch both boards to the compressed layout
+        finalize_board(player1);
+        finalize_board(player2);
         
         // Print both boards
-        print_board(player1);
-        printf("\n");
-        print_board(player2);
+        if (!input->quiet) {
+            print_board(player1);
+            printf("\n");
+            print_board(player2);
+        }
         
         // Game loop
         int current_player = 1;
         int game_over = 0;
+        int attempt = 0;
         
         while (!game_over) {
-            int attack_x, attack_y;
-            scanf("%d %d", &attack_x, &attack_y);
+            long long attack_x, attack_y;
+            status = read_number(input, &attack_x);
+            if (status == READ_OK) status = read_number(input, &attack_y);
+            if (status != READ_OK) {
+                if (!recover(input, game, status)) {
+                    result = GAME_STOP;
+                    break;
+                }
+                if (!input->quiet && ++attempt > input->max_retries) {
+                    abandon_game(input, game, player1, player2);
+                }
+                continue;
+            }
+            attempt = 0;
             
-            int result;
             if (current_player == 1) {
-                result = attack(player2, attack_x, attack_y, 1);
+                attack(player2, attack_x, attack_y, 1);
                 if (player2->ships_remaining == 0) {
-                    printf("Jucătorul 1 a câștigat!\n");
+                    if (!input->quiet) printf("Jucătorul 1 a câștigat!\n");
                     game_over = 1;
                 }
             } else {
-                result = attack(player1, attack_x, attack_y, 2);
+                attack(player1, attack_x, attack_y, 2);
                 if (player1->ships_remaining == 0) {
-                    printf("Jucătorul 2 a câștigat!\n");
+                    if (!input->quiet) printf("Jucătorul 2 a câștigat!\n");
                     game_over = 1;
                 }
             }
@@ -393,11 +715,51 @@ int main() {
             // Switch players
             current_player = (current_player == 1) ? 2 : 1;
         }
-        
-        // Clean up
-        destroy_board(player1);
-        destroy_board(player2);
     }
     
-    return 0;
+    // Clean up
+    destroy_board(player1);
+    destroy_board(player2);
+    if (input->quiet) {
+        // Input that ends inside it is reported by the next game's header
+        input->quiet = 0;
+        result = GAME_ABANDONED;
+    }
+    return result;
+}
+
+// test [--strict [max_retries]]
+//
+// --strict validates the input as a stream: bad records are reported on
+// stderr as "eroare octet=O joc=G motiv=R" and skipped up to the end of
+// their line. A ship or shot that keeps failing gives up on its game after
+// max_retries attempts: the rest of the game is read through without output
+// and the run goes on with the next game. A bad "N M" header stops the run,
+// since the game's length cannot be known without it.
+int main(int argc, char *argv[]) {
+    Input input = {stdin, 0, 0, 0, DEFAULT_MAX_RETRIES, 0, 0};
+    if (argc > 1 && strcmp(argv[1], "--strict") == 0) {
+        input.strict = 1;
+        if (argc > 2) input.max_retries = atoi(argv[2]);
+    }
+    
+    long long J;
+    int status = read_number(&input, &J);
+    if (status != READ_OK) {
+        input_error(&input, 0, status == READ_EOF ? "sfarsit" : "simbol");
+        return 1;
+    }
+    
+    int abandoned = 0;
+    for (int game = 0; game < J; game++) {
+        int result = play_game(&input, game);
+        if (result == GAME_ABANDONED) abandoned++;
+        if (result == GAME_STOP) break;
+    }
+    
+    if (input.strict) {
+        fprintf(stderr, "%lld erori, %d jocuri abandonate, %lld octeți citiți\n",
+                input.errors, abandoned, input.offset);
+    }
+    return input.errors != 0;
 }
@@ -2,107 +2,445 @@
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
 
-// Structure for ship
+// Ships of a board as parallel arrays indexed by ship. Attacks only touch
+// the hot state at the top; the geometry below is read when a hit needs the
+// segment index and by the printers.
 typedef struct {
-    char type;
-    int length;
-    int start_x, start_y;
-    char orientation;
-    int **cells;  // Array to track hits on each cell (x, y)
-    int hits_received;
-    int destroyed;
-} Ship;
+    unsigned char *hit_masks;  // Bit i = segment i hit (start excluded)
+    unsigned char *lengths;
+    uint64_t *destroyed;       // One bit per ship
+    int type_afloat[5];        // Ships not destroyed, per type (S Y B L A)
+    char *types;
+    char *orientations;
+    int *start_x, *start_y;
+} Fleet;
+
+// Pre-formatted text of a board, patched cell by cell
+typedef struct {
+    char *text;         // N rows of M cells, 2 bytes per cell ("d " or "d\n")
+    int row_bytes;
+    int dirty_first;    // Rows changed since the last emit, 0 if none
+    int dirty_last;
+} BoardView;
+
+// Compact record of something that happened in a game
+typedef struct {
+    unsigned char kind;       // EVENT_*
+    unsigned char player;     // Player who acted
+    char ship_type;           // Ship involved, 0 if none
+    unsigned char result;     // attack() result for EVENT_HIT, HIT_HEAD if
+                              // the ship sank from a hit on its start
+    int x, y;
+} GameEvent;
+
+#define EVENT_PLACE 1  // A ship was placed
+#define EVENT_HIT   2  // A ship was hit (result 2 if it sank)
+#define EVENT_WIN   3  // The player won the game
+
+#define HIT_HEAD 3     // Event result of a hit on a ship's start coordinate
+
+// Lock-free single producer, single consumer ring of game events. The game
+// thread publishes, a consumer renders or aggregates them off the hot path.
+typedef struct {
+    GameEvent *slots;
+    uint64_t mask;            // Capacity - 1, capacity is a power of two
+    _Atomic uint64_t head;    // Next slot the producer writes
+    _Atomic uint64_t tail;    // Next slot the consumer reads
+    _Atomic uint64_t done;    // Events the consumer has fully handled; the
+                              // slot is free at tail, the output is out at done
+    atomic_int closed;
+} EventRing;
+
+// Boards are stored in 64 x 64 tiles that are only allocated when one of
+// their cells is written, so memory follows the occupied area, not N x M
+#define TILE_SHIFT 6
+#define TILE_SIZE (1 << TILE_SHIFT)
+
+typedef struct {
+    int owners[TILE_SIZE * TILE_SIZE];  // 0 = empty, k = ship index k - 1
+    uint64_t hits[TILE_SIZE];           // One word per tile row, 1 = hit
+} BoardTile;
 
 // Structure for player board
 typedef struct {
     int N, M;
     int ship_count;
-    Ship *ships;
-    int **board;  // 2D array: 0 = empty, 1-5 = ship index
-    int **hits;   // 2D array: 0 = not hit, 1 = hit
+    Fleet fleet;
+    int tile_rows, tile_cols;
+    BoardTile **tiles;  // Tile directory, NULL entries are untouched water
+    BoardTile **shared_tiles;  // Directory of the layout this board was cloned
+                               // from; its tiles are copied before a write
     int ships_remaining;
+    int silent;       // Skip the hit messages, used by search code
+    EventRing *events;  // Publish hits here instead of printing them
+    BoardView *view;  // Optional incremental renderer
 } PlayerBoard;
 
+// What one attack changed, enough to undo it. Shared by both engines; the
+// bitboard engine has no hit masks and leaves hit_mask alone.
+typedef struct {
+    int x, y;
+    int was_hit;          // Cell was already hit (or off the board)
+    int ship;             // Ship at the cell, -1 for water
+    unsigned char hit_mask;  // Previous state of that ship
+    int destroyed;
+    int ships_remaining;
+} JournalEntry;
+
+// Undo stack for make_attack()/unmake_attack()
+typedef struct {
+    JournalEntry *entries;
+    int count;
+    int capacity;
+} AttackJournal;
+
+// One ship of a fleet submitted in bulk
+typedef struct {
+    char type, orientation;
+    int x, y;
+} ShipPlacement;
+
+// Per ship results of validate_fleet()
+#define FLEET_OK       0
+#define FLEET_BAD_SHIP 1  // Unknown type or orientation, or off the board
+#define FLEET_QUOTA    2  // More ships of this type than the board allows
+#define FLEET_OVERLAP  3  // Shares a cell with another ship
+
 // Function prototypes
 PlayerBoard* create_board(int N, int M, int ship_count);
+PlayerBoard* clone_board(PlayerBoard *layout);
+void reset_board(PlayerBoard *board);
 void destroy_board(PlayerBoard *board);
 int place_ship(PlayerBoard *board, char type, char orientation, int x, int y, int ship_index);
 int is_valid_placement(PlayerBoard *board, char type, char orientation, int x, int y);
+int validate_fleet(int N, int M, ShipPlacement *fleet, int count, int *errors);
+int place_fleet(PlayerBoard *board, ShipPlacement *fleet, int count, int *errors);
 void print_board(PlayerBoard *board);
+void attach_view(PlayerBoard *board);
+void emit_view(PlayerBoard *board, const char *title, int full);
 int attack(PlayerBoard *board, int x, int y, int player_num);
+int salvo_attack(PlayerBoard *board, int shots[][2], int shot_count, int player_num, int *results);
+int make_attack(PlayerBoard *board, int x, int y, AttackJournal *journal);
+void unmake_attack(PlayerBoard *board, AttackJournal *journal);
 int get_ship_length(char type);
 char* get_ship_name(char type);
+int type_index(char type);
 int calculate_ships_per_type(int N, int M, char type);
+int calculate_total_ships(int N, int M);
 
 // Calculate number of ships for a given type
 int calculate_ships_per_type(int N, int M, char type) {
     switch (type) {
-        case 'S': return (N * M) / 70;  // Shinano
-        case 'Y': return (N * M) / 55;  // Yamato
-        case 'B': return (N * M) / 40;  // Belfast
-        case 'L': return (N * M) / 30;  // Laffey
-        case 'A': return (N * M) / 20;  // Albacore
+        case 'S': return (int)(((long long)N * M) / 70);  // Shinano
+        case 'Y': return (int)(((long long)N * M) / 55);  // Yamato
+        case 'B': return (int)(((long long)N * M) / 40);  // Belfast
+        case 'L': return (int)(((long long)N * M) / 30);  // Laffey
+        case 'A': return (int)(((long long)N * M) / 20);  // Albacore
         default: return 0;
     }
 }
 
-// Create a new board with 2D arrays
+// Calculate total number of ships for a board
+int calculate_total_ships(int N, int M) {
+    int total_ships = 0;
+    total_ships += calculate_ships_per_type(N, M, 'S');
+    total_ships += calculate_ships_per_type(N, M, 'Y');
+    total_ships += calculate_ships_per_type(N, M, 'B');
+    total_ships += calculate_ships_per_type(N, M, 'L');
+    total_ships += calculate_ships_per_type(N, M, 'A');
+    return total_ships;
+}
+
+// Create an event ring with room for at least capacity events
+EventRing* create_event_ring(int capacity) {
+    EventRing *ring = (EventRing*)malloc(sizeof(EventRing));
+    uint64_t size = 1;
+    while (size < (uint64_t)capacity) size <<= 1;
+    
+    ring->slots = (GameEvent*)malloc(size * sizeof(GameEvent));
+    ring->mask = size - 1;
+    atomic_store(&ring->head, 0);
+    atomic_store(&ring->tail, 0);
+    atomic_store(&ring->done, 0);
+    atomic_store(&ring->closed, 0);
+    return ring;
+}
+
+void destroy_event_ring(EventRing *ring) {
+    if (!ring) return;
+    free(ring->slots);
+    free(ring);
+}
+
+// Producer side; waits for the consumer if the ring is full
+void publish_event(EventRing *ring, int kind, int player, char ship_type, int result, int x, int y) {
+    uint64_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    while (head - atomic_load_explicit(&ring->tail, memory_order_acquire) > ring->mask) {
+        sched_yield();
+    }
+    
+    GameEvent *event = &ring->slots[head & ring->mask];
+    event->kind = (unsigned char)kind;
+    event->player = (unsigned char)player;
+    event->ship_type = ship_type;
+    event->result = (unsigned char)result;
+    event->x = x;
+    event->y = y;
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+}
+
+// Consumer side; returns 0 if there is nothing to read
+int consume_event(EventRing *ring, GameEvent *event) {
+    uint64_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    if (tail == atomic_load_explicit(&ring->head, memory_order_acquire)) {
+        return 0;
+    }
+    *event = ring->slots[tail & ring->mask];
+    atomic_store_explicit(&ring->tail, tail + 1, memory_order_release);
+    return 1;
+}
+
+// Consumer side; everything consumed so far has been handled
+static inline void finish_events(EventRing *ring) {
+    atomic_store_explicit(&ring->done, atomic_load_explicit(&ring->tail, memory_order_relaxed),
+                          memory_order_release);
+}
+
+// Wait until the consumer has handled everything published so far, so the
+// caller's own output comes after it
+void drain_event_ring(EventRing *ring) {
+    while (atomic_load_explicit(&ring->done, memory_order_acquire) !=
+           atomic_load_explicit(&ring->head, memory_order_acquire)) {
+        sched_yield();
+    }
+}
+
+// Print the usual message for an event
+void render_event(const GameEvent *event) {
+    switch (event->kind) {
+        case EVENT_HIT:
+            printf("Jucătorul %d a lovit o navă %s la coordonata (%d, %d).\n", 
+                   event->player, get_ship_name(event->ship_type), event->x, event->y);
+            break;
+        case EVENT_WIN:
+            printf("Jucătorul %d a câștigat!\n", event->player);
+            break;
+    }
+}
+
+// Consumer thread rendering a ring until it is closed and empty
+void* render_events(void *arg) {
+    EventRing *ring = (EventRing*)arg;
+    GameEvent event;
+    
+    while (1) {
+        if (consume_event(ring, &event)) {
+            render_event(&event);
+            if (event.kind == EVENT_WIN) fflush(stdout);
+            finish_events(ring);
+        } else if (atomic_load(&ring->closed)) {
+            if (!consume_event(ring, &event)) break;
+            render_event(&event);
+            finish_events(ring);
+        } else {
+            sched_yield();
+        }
+    }
+    
+    fflush(stdout);
+    return NULL;
+}
+
+// Report a hit: publish it when the board has a ring, print it otherwise
+static void report_hit(EventRing *events, int silent, int player_num, char type, int x, int y, int result) {
+    if (events) {
+        publish_event(events, EVENT_HIT, player_num, type, result, x, y);
+    } else if (!silent) {
+        printf("Jucătorul %d a lovit o navă %s la coordonata (%d, %d).\n", 
+               player_num, get_ship_name(type), x, y);
+    }
+}
+
+// Tile holding cell (x, y), or NULL if nothing was written there yet
+static inline BoardTile* find_tile(PlayerBoard *board, int x, int y) {
+    return board->tiles[(size_t)((x - 1) >> TILE_SHIFT) * board->tile_cols + ((y - 1) >> TILE_SHIFT)];
+}
+
+// Tile holding cell (x, y), ready to be written
+static inline BoardTile* get_tile(PlayerBoard *board, int x, int y) {
+    size_t i = (size_t)((x - 1) >> TILE_SHIFT) * board->tile_cols + ((y - 1) >> TILE_SHIFT);
+    BoardTile **slot = &board->tiles[i];
+    if (!*slot) {
+        *slot = (BoardTile*)calloc(1, sizeof(BoardTile));
+    } else if (board->shared_tiles && *slot == board->shared_tiles[i]) {
+        // Still the layout's tile: copy on first write
+        BoardTile *copy = (BoardTile*)malloc(sizeof(BoardTile));
+        memcpy(copy, *slot, sizeof(BoardTile));
+        *slot = copy;
+    }
+    return *slot;
+}
+
+static inline int tile_cell(int x, int y) {
+    return ((x - 1) & (TILE_SIZE - 1)) * TILE_SIZE + ((y - 1) & (TILE_SIZE - 1));
+}
+
+// Ship index + 1 at (x, y), 0 for water
+static inline int cell_owner(PlayerBoard *board, int x, int y) {
+    BoardTile *tile = find_tile(board, x, y);
+    return tile ? tile->owners[tile_cell(x, y)] : 0;
+}
+
+static inline int cell_hit(PlayerBoard *board, int x, int y) {
+    BoardTile *tile = find_tile(board, x, y);
+    return tile ? (int)((tile->hits[(x - 1) & (TILE_SIZE - 1)] >> ((y - 1) & (TILE_SIZE - 1))) & 1) : 0;
+}
+
+static inline void set_cell_hit(PlayerBoard *board, int x, int y) {
+    get_tile(board, x, y)->hits[(x - 1) & (TILE_SIZE - 1)] |= (uint64_t)1 << ((y - 1) & (TILE_SIZE - 1));
+}
+
+static inline void clear_cell_hit(PlayerBoard *board, int x, int y) {
+    // A hit tile was already copied, so only those are written
+    if (cell_hit(board, x, y)) {
+        find_tile(board, x, y)->hits[(x - 1) & (TILE_SIZE - 1)] &= ~((uint64_t)1 << ((y - 1) & (TILE_SIZE - 1)));
+    }
+}
+
+// Length of the ship at (x, y), 0 for water
+static inline int cell_length(PlayerBoard *board, int x, int y) {
+    int owner = cell_owner(board, x, y);
+    return owner ? board->fleet.lengths[owner - 1] : 0;
+}
+
+static inline int ship_destroyed(Fleet *fleet, int ship) {
+    return (int)((fleet->destroyed[ship >> 6] >> (ship & 63)) & 1);
+}
+
+static inline void set_ship_destroyed(Fleet *fleet, int ship, int destroyed) {
+    uint64_t bit = (uint64_t)1 << (ship & 63);
+    if (destroyed) {
+        fleet->destroyed[ship >> 6] |= bit;
+    } else {
+        fleet->destroyed[ship >> 6] &= ~bit;
+    }
+}
+
+// Create a new board with an empty tile directory
 PlayerBoard* create_board(int N, int M, int ship_count) {
     PlayerBoard *board = (PlayerBoard*)malloc(sizeof(PlayerBoard));
     board->N = N;
     board->M = M;
     board->ship_count = ship_count;
     board->ships_remaining = ship_count;
+    board->silent = 0;
+    board->events = NULL;
+    board->view = NULL;
     
-    // Allocate ships array
-    board->ships = (Ship*)malloc(ship_count * sizeof(Ship));
+    // Allocate fleet arrays
+    Fleet *fleet = &board->fleet;
+    fleet->hit_masks = (unsigned char*)calloc(ship_count + 1, 1);
+    fleet->lengths = (unsigned char*)calloc(ship_count + 1, 1);
+    fleet->destroyed = (uint64_t*)calloc((ship_count >> 6) + 1, sizeof(uint64_t));
+    memset(fleet->type_afloat, 0, sizeof(fleet->type_afloat));
+    fleet->types = (char*)calloc(ship_count + 1, 1);
+    fleet->orientations = (char*)calloc(ship_count + 1, 1);
+    fleet->start_x = (int*)calloc(ship_count + 1, sizeof(int));
+    fleet->start_y = (int*)calloc(ship_count + 1, sizeof(int));
     
-    // Allocate and initialize board (ship indices)
-    board->board = (int**)malloc((N + 2) * sizeof(int*));
-    for (int i = 0; i <= N + 1; i++) {
-        board->board[i] = (int*)calloc((M + 2), sizeof(int));
-    }
+    // Allocate tile directory, tiles come on first write
+    board->tile_rows = (N + TILE_SIZE - 1) >> TILE_SHIFT;
+    board->tile_cols = (M + TILE_SIZE - 1) >> TILE_SHIFT;
+    board->tiles = (BoardTile**)calloc((size_t)board->tile_rows * board->tile_cols + 1, sizeof(BoardTile*));
+    board->shared_tiles = NULL;
     
-    // Allocate and initialize hits array
-    board->hits = (int**)malloc((N + 2) * sizeof(int*));
-    for (int i = 0; i <= N + 1; i++) {
-        board->hits[i] = (int*)calloc((M + 2), sizeof(int));
-    }
+    return board;
+}
+
+// Board with its own hit state over the ships of a fully placed layout. The
+// ship geometry and the tiles are borrowed; a tile is copied when it is
+// first hit. The layout must not change and must outlive the clone.
+PlayerBoard* clone_board(PlayerBoard *layout) {
+    PlayerBoard *board = (PlayerBoard*)malloc(sizeof(PlayerBoard));
+    *board = *layout;
+    board->silent = 0;
+    board->events = NULL;
+    board->view = NULL;
     
-    // Initialize ships
-    for (int i = 0; i < ship_count; i++) {
-        board->ships[i].cells = NULL;
-        board->ships[i].destroyed = 0;
-        board->ships[i].hits_received = 0;
-    }
+    // Hot fleet state is the only part of the fleet that changes
+    size_t destroyed_bytes = ((layout->ship_count >> 6) + 1) * sizeof(uint64_t);
+    board->fleet.hit_masks = (unsigned char*)malloc(layout->ship_count + 1);
+    memcpy(board->fleet.hit_masks, layout->fleet.hit_masks, layout->ship_count + 1);
+    board->fleet.destroyed = (uint64_t*)malloc(destroyed_bytes);
+    memcpy(board->fleet.destroyed, layout->fleet.destroyed, destroyed_bytes);
     
+    size_t tiles = (size_t)layout->tile_rows * layout->tile_cols + 1;
+    board->tiles = (BoardTile**)malloc(tiles * sizeof(BoardTile*));
+    memcpy(board->tiles, layout->tiles, tiles * sizeof(BoardTile*));
+    board->shared_tiles = layout->tiles;
     return board;
 }
 
+// Empty an owned board for the next game, keeping its tiles allocated so
+// that pooled boards do not go back to the allocator
+void reset_board(PlayerBoard *board) {
+    Fleet *fleet = &board->fleet;
+    for (int i = 0; i < board->ship_count; i++) {
+        if (fleet->lengths[i] == 0) continue;
+        for (int k = 0; k < fleet->lengths[i]; k++) {
+            int x = (fleet->orientations[i] == 'H') ? fleet->start_x[i] : fleet->start_x[i] - k;
+            int y = (fleet->orientations[i] == 'H') ? fleet->start_y[i] + k : fleet->start_y[i];
+            find_tile(board, x, y)->owners[tile_cell(x, y)] = 0;
+        }
+    }
+    for (size_t i = 0; i < (size_t)board->tile_rows * board->tile_cols; i++) {
+        if (board->tiles[i]) memset(board->tiles[i]->hits, 0, sizeof(board->tiles[i]->hits));
+    }
+    
+    memset(fleet->hit_masks, 0, board->ship_count + 1);
+    memset(fleet->lengths, 0, board->ship_count + 1);
+    memset(fleet->destroyed, 0, ((board->ship_count >> 6) + 1) * sizeof(uint64_t));
+    memset(fleet->type_afloat, 0, sizeof(fleet->type_afloat));
+    board->ships_remaining = board->ship_count;
+}
+
 // Destroy board and free all memory
 void destroy_board(PlayerBoard *board) {
     if (!board) return;
     
-    // Free ships and their cell arrays
-    for (int i = 0; i < board->ship_count; i++) {
-        if (board->ships[i].cells) {
-            free(board->ships[i].cells);
-        }
+    // Free fleet arrays, a clone owns only the hot ones
+    free(board->fleet.hit_masks);
+    free(board->fleet.destroyed);
+    if (!board->shared_tiles) {
+        free(board->fleet.lengths);
+        free(board->fleet.types);
+        free(board->fleet.orientations);
+        free(board->fleet.start_x);
+        free(board->fleet.start_y);
     }
-    free(board->ships);
     
-    // Free board array
-    for (int i = 0; i <= board->N + 1; i++) {
-        free(board->board[i]);
+    // Free tiles and their directory
+    for (size_t i = 0; i < (size_t)board->tile_rows * board->tile_cols; i++) {
+        if (!board->shared_tiles || board->tiles[i] != board->shared_tiles[i]) free(board->tiles[i]);
     }
-    free(board->board);
+    free(board->tiles);
     
-    // Free hits array
-    for (int i = 0; i <= board->N + 1; i++) {
-        free(board->hits[i]);
+    // Free renderer
+    if (board->view) {
+        free(board->view->text);
+        free(board->view);
     }
-    free(board->hits);
     
     free(board);
 }
@@ -119,6 +457,18 @@ int get_ship_length(char type) {
     }
 }
 
+// Position of a type in the S Y B L A order, -1 if unknown
+int type_index(char type) {
+    switch (toupper(type)) {
+        case 'S': return 0;
+        case 'Y': return 1;
+        case 'B': return 2;
+        case 'L': return 3;
+        case 'A': return 4;
+        default: return -1;
+    }
+}
+
 // Get ship name
 char* get_ship_name(char type) {
     switch (toupper(type)) {
@@ -147,7 +497,7 @@ int is_valid_placement(PlayerBoard *board, char type, char orientation, int x, i
         }
         // Check for collisions
         for (int i = 0; i < length; i++) {
-            if (board->board[x][y + i] != 0) {
+            if (cell_owner(board, x, y + i) != 0) {
                 return 0;  // Collision
             }
         }
@@ -157,7 +507,7 @@ int is_valid_placement(PlayerBoard *board, char type, char orientation, int x, i
         }
         // Check for collisions
         for (int i = 0; i < length; i++) {
-            if (board->board[x - i][y] != 0) {
+            if (cell_owner(board, x - i, y) != 0) {
                 return 0;  // Collision
             }
         }
@@ -168,243 +518,4918 @@ int is_valid_placement(PlayerBoard *board, char type, char orientation, int x, i
     return 1;
 }
 
-// Place a ship on the board
-int place_ship(PlayerBoard *board, char type, char orientation, int x, int y, int ship_index) {
-    if (!is_valid_placement(board, type, orientation, x, y)) {
-        return 0;
+// Character shown for a cell: ship length, 'X' for a hit ship, 'o' for a miss
+static char view_cell(PlayerBoard *board, int x, int y) {
+    if (cell_hit(board, x, y)) {
+        return cell_owner(board, x, y) ? 'X' : 'o';
     }
+    return (char)('0' + cell_length(board, x, y));
+}
+
+// Re-render a single cell of the attached view
+static void patch_view(PlayerBoard *board, int x, int y) {
+    BoardView *view = board->view;
+    if (!view) return;
     
+    view->text[(x - 1) * view->row_bytes + (y - 1) * 2] = view_cell(board, x, y);
+    if (view->dirty_first == 0 || x < view->dirty_first) view->dirty_first = x;
+    if (x > view->dirty_last) view->dirty_last = x;
+}
+
+// Write a ship that is known to fit into the board
+static void put_ship(PlayerBoard *board, char type, char orientation, int x, int y, int ship_index) {
     int length = get_ship_length(type);
+    Fleet *fleet = &board->fleet;
     
     // Initialize ship
-    board->ships[ship_index].type = type;
-    board->ships[ship_index].length = length;
-    board->ships[ship_index].start_x = x;
-    board->ships[ship_index].start_y = y;
-    board->ships[ship_index].orientation = orientation;
-    board->ships[ship_index].hits_received = 0;
-    board->ships[ship_index].destroyed = 0;
-    
-    // Allocate cells array to track ship's occupied positions
-    board->ships[ship_index].cells = (int**)malloc(length * sizeof(int*));
-    for (int i = 0; i < length; i++) {
-        board->ships[ship_index].cells[i] = (int*)malloc(2 * sizeof(int));
-    }
+    fleet->hit_masks[ship_index] = 0;
+    fleet->lengths[ship_index] = (unsigned char)length;
+    set_ship_destroyed(fleet, ship_index, 0);
+    fleet->type_afloat[type_index(type)]++;
+    fleet->types[ship_index] = type;
+    fleet->orientations[ship_index] = orientation;
+    fleet->start_x[ship_index] = x;
+    fleet->start_y[ship_index] = y;
     
-    // Mark ship on board and store cell coordinates
+    // Mark ship on board
     if (orientation == 'H') {
         for (int i = 0; i < length; i++) {
-            board->board[x][y + i] = length;  // Store ship length
-            board->ships[ship_index].cells[i][0] = x;
-            board->ships[ship_index].cells[i][1] = y + i;
+            get_tile(board, x, y + i)->owners[tile_cell(x, y + i)] = ship_index + 1;
+            patch_view(board, x, y + i);
         }
     } else {  // Vertical
         for (int i = 0; i < length; i++) {
-            board->board[x - i][y] = length;  // Store ship length
-            board->ships[ship_index].cells[i][0] = x - i;
-            board->ships[ship_index].cells[i][1] = y;
+            get_tile(board, x - i, y)->owners[tile_cell(x - i, y)] = ship_index + 1;
+            patch_view(board, x - i, y);
         }
     }
+}
+
+// Place a ship on the board
+int place_ship(PlayerBoard *board, char type, char orientation, int x, int y, int ship_index) {
+    if (!is_valid_placement(board, type, orientation, x, y)) {
+        return 0;
+    }
     
+    put_ship(board, type, orientation, x, y, ship_index);
     return 1;
 }
 
+// Cell of a ship in a submitted fleet, for the overlap sweep
+typedef struct {
+    long long key;  // (x - 1) * M + (y - 1)
+    int ship;
+} FleetCell;
+
+static int compare_fleet_cells(const void *a, const void *b) {
+    const FleetCell *c1 = a, *c2 = b;
+    if (c1->key != c2->key) return (c1->key > c2->key) - (c1->key < c2->key);
+    return c1->ship - c2->ship;
+}
+
+// Check a whole fleet at once: bounds, per type quota, then every overlap in
+// one sweep over the sorted ship cells. errors[i] gets a FLEET_* code for
+// each ship; returns the number of invalid ships, or -1 if ships are missing.
+int validate_fleet(int N, int M, ShipPlacement *fleet, int count, int *errors) {
+    static const char types[] = "SYBLA";
+    int quota[5];
+    int invalid = 0;
+    
+    for (int t = 0; t < 5; t++) {
+        quota[t] = calculate_ships_per_type(N, M, types[t]);
+    }
+    
+    FleetCell *cells = (FleetCell*)malloc((size_t)(count + 1) * 5 * sizeof(FleetCell));
+    int cell_count = 0;
+    
+    for (int i = 0; i < count; i++) {
+        ShipPlacement *ship = &fleet[i];
+        char type = (char)toupper(ship->type);
+        int length = get_ship_length(type);
+        int t = (int)(strchr(types, type) - types);
+        
+        errors[i] = FLEET_OK;
+        if (length == 0 || (ship->orientation != 'H' && ship->orientation != 'V') ||
+            ship->x < 1 || ship->x > N || ship->y < 1 || ship->y > M ||
+            (ship->orientation == 'H' && ship->y + length - 1 > M) ||
+            (ship->orientation == 'V' && ship->x - length + 1 < 1)) {
+            errors[i] = FLEET_BAD_SHIP;
+        } else if (quota[t]-- <= 0) {
+            errors[i] = FLEET_QUOTA;
+        }
+        if (errors[i] != FLEET_OK) continue;
+        
+        for (int k = 0; k < length; k++) {
+            int x = (ship->orientation == 'H') ? ship->x : ship->x - k;
+            int y = (ship->orientation == 'H') ? ship->y + k : ship->y;
+            cells[cell_count].key = (long long)(x - 1) * M + (y - 1);
+            cells[cell_count].ship = i;
+            cell_count++;
+        }
+    }
+    
+    // Equal neighbours after sorting are shared cells
+    qsort(cells, cell_count, sizeof(FleetCell), compare_fleet_cells);
+    for (int k = 1; k < cell_count; k++) {
+        if (cells[k].key == cells[k - 1].key) {
+            errors[cells[k].ship] = FLEET_OVERLAP;
+            errors[cells[k - 1].ship] = FLEET_OVERLAP;
+        }
+    }
+    free(cells);
+    
+    for (int i = 0; i < count; i++) {
+        if (errors[i] != FLEET_OK) invalid++;
+    }
+    if (invalid == 0 && count < calculate_total_ships(N, M)) {
+        return -1;
+    }
+    return invalid;
+}
+
+// Validate and place a whole fleet on an empty board. Nothing is placed
+// unless every ship is valid; the result is the same as validate_fleet().
+int place_fleet(PlayerBoard *board, ShipPlacement *fleet, int count, int *errors) {
+    int invalid = validate_fleet(board->N, board->M, fleet, count, errors);
+    if (invalid != 0 || count != board->ship_count) {
+        return invalid;
+    }
+    
+    for (int i = 0; i < count; i++) {
+        put_ship(board, fleet[i].type, fleet[i].orientation, fleet[i].x, fleet[i].y, i);
+    }
+    return 0;
+}
+
 // Print board
 void print_board(PlayerBoard *board) {
     for (int i = 1; i <= board->N; i++) {
         for (int j = 1; j <= board->M; j++) {
-            printf("%d", board->board[i][j]);
+            printf("%d", cell_length(board, i, j));
             if (j < board->M) printf(" ");
         }
         printf("\n");
     }
 }
 
-// Process an attack on a board
-int attack(PlayerBoard *board, int x, int y, int player_num) {
-    // Check bounds
-    if (x < 1 || x > board->N || y < 1 || y > board->M) {
-        return 0;  // Miss (out of bounds)
-    }
+// Attach an incremental renderer; the board is formatted once here and
+// afterwards only the cells touched by place_ship() and attack() change
+void attach_view(PlayerBoard *board) {
+    if (board->view) return;
     
-    // Check if position was already hit
-    if (board->hits[x][y]) {
-        return -1;  // Already hit, lose turn
+    BoardView *view = (BoardView*)malloc(sizeof(BoardView));
+    view->row_bytes = 2 * board->M;
+    view->text = (char*)malloc((size_t)board->N * view->row_bytes + 1);
+    
+    for (int i = 1; i <= board->N; i++) {
+        char *row = view->text + (size_t)(i - 1) * view->row_bytes;
+        for (int j = 1; j <= board->M; j++) {
+            row[(j - 1) * 2] = view_cell(board, i, j);
+            row[(j - 1) * 2 + 1] = (j < board->M) ? ' ' : '\n';
+        }
     }
+    view->dirty_first = 0;
+    view->dirty_last = 0;
+    board->view = view;
+}
+
+// Write the view straight from its buffer: every row when full is set,
+// otherwise only the rows changed since the last emit
+void emit_view(PlayerBoard *board, const char *title, int full) {
+    BoardView *view = board->view;
+    if (!view) return;
     
-    // Mark as hit
-    board->hits[x][y] = 1;
+    int first = full ? 1 : view->dirty_first;
+    int last = full ? board->N : view->dirty_last;
+    view->dirty_first = 0;
+    view->dirty_last = 0;
+    if (first == 0 || board->N == 0) return;
     
-    // Check if there's a ship at this position
-    if (board->board[x][y] == 0) {
-        return 0;  // Miss (water)
-    }
+    char header[96];
+    int header_len = snprintf(header, sizeof(header), "%s (rândurile %d-%d):\n", title, first, last);
     
-    // Find which ship is at this position
-    int ship_length = board->board[x][y];
-    Ship *found_ship = NULL;
-    int ship_index = -1;
+    struct iovec parts[2];
+    parts[0].iov_base = header;
+    parts[0].iov_len = (size_t)header_len;
+    parts[1].iov_base = view->text + (size_t)(first - 1) * view->row_bytes;
+    parts[1].iov_len = (size_t)(last - first + 1) * view->row_bytes;
     
-    // Search for the ship containing this cell
-    for (int i = 0; i < board->ship_count; i++) {
-        if (board->ships[i].destroyed) continue;
-        
-        for (int j = 0; j < board->ships[i].length; j++) {
-            int ship_x = board->ships[i].cells[j][0];
-            int ship_y = board->ships[i].cells[j][1];
-            
-            if (ship_x == x && ship_y == y) {
-                found_ship = &board->ships[i];
-                ship_index = i;
-                break;
-            }
-        }
-        if (found_ship) break;
+    // Keep ordering with anything still sitting in the stdio buffer
+    fflush(stdout);
+    ssize_t written = writev(STDOUT_FILENO, parts, 2);
+    (void)written;
+}
+
+// Apply a hit on a ship cell that was not hit before
+static int resolve_hit(PlayerBoard *board, int ship, int x, int y, int player_num) {
+    Fleet *fleet = &board->fleet;
+    if (ship_destroyed(fleet, ship)) {
+        return 0;  // Remains of a sunk ship count as water
     }
     
-    if (!found_ship) {
-        return 0;  // Should not happen
-    }
+    // Segment index from the start: 0 is the start coordinate
+    int segment = (fleet->orientations[ship] == 'H') ? y - fleet->start_y[ship] : fleet->start_x[ship] - x;
+    char type = fleet->types[ship];
     
     // Check if hitting the start coordinate
-    if (x == found_ship->start_x && y == found_ship->start_y) {
+    if (segment == 0) {
         // Destroy entire ship immediately
-        found_ship->destroyed = 1;
+        set_ship_destroyed(fleet, ship, 1);
+        fleet->type_afloat[type_index(type)]--;
         board->ships_remaining--;
-        printf("Jucătorul %d a lovit o navă %s la coordonata (%d, %d).\n", 
-               player_num, get_ship_name(found_ship->type), x, y);
+        report_hit(board->events, board->silent, player_num, type, x, y, HIT_HEAD);
         return 2;  // Ship destroyed
     }
     
     // Regular hit
-    found_ship->hits_received++;
-    
-    printf("Jucătorul %d a lovit o navă %s la coordonata (%d, %d).\n", 
-           player_num, get_ship_name(found_ship->type), x, y);
+    fleet->hit_masks[ship] |= (unsigned char)(1 << segment);
     
     // Check if ship is now destroyed
-    if (found_ship->hits_received == found_ship->length) {
-        found_ship->destroyed = 1;
+    if (__builtin_popcount(fleet->hit_masks[ship]) == fleet->lengths[ship]) {
+        set_ship_destroyed(fleet, ship, 1);
+        fleet->type_afloat[type_index(type)]--;
         board->ships_remaining--;
+        report_hit(board->events, board->silent, player_num, type, x, y, 2);
         return 2;  // Ship destroyed
     }
     
+    report_hit(board->events, board->silent, player_num, type, x, y, 1);
     return 1;  // Hit but not destroyed
 }
 
-int main() {
-    int J;
-    scanf("%d", &J);
+// Process an attack on a board
+int attack(PlayerBoard *board, int x, int y, int player_num) {
+    // Check bounds
+    if (x < 1 || x > board->N || y < 1 || y > board->M) {
+        return 0;  // Miss (out of bounds)
+    }
     
-    for (int game = 0; game < J; game++) {
-        int N, M;
-        scanf("%d %d", &N, &M);
-        
-        // Calculate total number of ships
-        int total_ships = 0;
-        total_ships += calculate_ships_per_type(N, M, 'S');
-        total_ships += calculate_ships_per_type(N, M, 'Y');
-        total_ships += calculate_ships_per_type(N, M, 'B');
-        total_ships += calculate_ships_per_type(N, M, 'L');
-        total_ships += calculate_ships_per_type(N, M, 'A');
-        
-        // Create boards for both players
-        PlayerBoard *player1 = create_board(N, M, total_ships);
-        PlayerBoard *player2 = create_board(N, M, total_ships);
-        
-        // Place ships for player 1
-        char ship_types[] = {'S', 'Y', 'B', 'L', 'A'};
-        int ship_index = 0;
-        
-        for (int type_idx = 0; type_idx < 5; type_idx++) {
-            int ships_count = calculate_ships_per_type(N, M, ship_types[type_idx]);
-            for (int i = 0; i < ships_count; i++) {
-                while (1) {
-                    char type, orientation;
-                    int x, y;
-                    scanf(" %c %c %d %d", &type, &orientation, &x, &y);
-                    
-                    if (place_ship(player1, type, orientation, x, y, ship_index)) {
-                        ship_index++;
-                        break;
-                    } else {
-                        printf("Eroare: navă invalidă. Încercați din nou.\n");
-                    }
-                }
-            }
-        }
-        
-        // Place ships for player 2
-        ship_index = 0;
-        for (int type_idx = 0; type_idx < 5; type_idx++) {
-            int ships_count = calculate_ships_per_type(N, M, ship_types[type_idx]);
-            for (int i = 0; i < ships_count; i++) {
-                while (1) {
-                    char type, orientation;
-                    int x, y;
-                    scanf(" %c %c %d %d", &type, &orientation, &x, &y);
-                    
-                    if (place_ship(player2, type, orientation, x, y, ship_index)) {
-                        ship_index++;
-                        break;
-                    } else {
-                        printf("Eroare: navă invalidă. Încercați din nou.\n");
-                    }
-                }
-            }
+    // Check if position was already hit
+    if (cell_hit(board, x, y)) {
+        return -1;  // Already hit, lose turn
+    }
+    
+    // Mark as hit
+    set_cell_hit(board, x, y);
+    patch_view(board, x, y);
+    
+    // Check if there's a ship at this position
+    int owner = cell_owner(board, x, y);
+    if (owner == 0) {
+        return 0;  // Miss (water)
+    }
+    
+    return resolve_hit(board, owner - 1, x, y, player_num);
+}
+
+// Silent attack() that records what it changes, so search code can try a
+// shot and take it back in O(1) instead of copying the board
+int make_attack(PlayerBoard *board, int x, int y, AttackJournal *journal) {
+    if (journal->count == journal->capacity) {
+        journal->capacity = journal->capacity ? journal->capacity * 2 : 64;
+        journal->entries = (JournalEntry*)realloc(journal->entries,
+                                                  journal->capacity * sizeof(JournalEntry));
+    }
+    
+    JournalEntry *entry = &journal->entries[journal->count++];
+    int on_board = (x >= 1 && x <= board->N && y >= 1 && y <= board->M);
+    entry->x = x;
+    entry->y = y;
+    entry->was_hit = on_board ? cell_hit(board, x, y) : 1;
+    entry->ship = on_board ? cell_owner(board, x, y) - 1 : -1;
+    if (entry->ship >= 0) {
+        entry->hit_mask = board->fleet.hit_masks[entry->ship];
+        entry->destroyed = ship_destroyed(&board->fleet, entry->ship);
+    }
+    entry->ships_remaining = board->ships_remaining;
+    
+    int silent = board->silent;
+    EventRing *events = board->events;
+    board->silent = 1;
+    board->events = NULL;
+    int result = attack(board, x, y, 0);
+    board->silent = silent;
+    board->events = events;
+    return result;
+}
+
+// Undo the last make_attack()
+void unmake_attack(PlayerBoard *board, AttackJournal *journal) {
+    if (journal->count == 0) return;
+    
+    JournalEntry *entry = &journal->entries[--journal->count];
+    if (!entry->was_hit) {
+        clear_cell_hit(board, entry->x, entry->y);
+        patch_view(board, entry->x, entry->y);
+    }
+    if (entry->ship >= 0) {
+        Fleet *fleet = &board->fleet;
+        if (ship_destroyed(fleet, entry->ship) && !entry->destroyed) {
+            fleet->type_afloat[type_index(fleet->types[entry->ship])]++;
         }
+        fleet->hit_masks[entry->ship] = entry->hit_mask;
+        set_ship_destroyed(fleet, entry->ship, entry->destroyed);
+    }
+    board->ships_remaining = entry->ships_remaining;
+}
+
+// Process a whole salvo in one pass over the hit and ship index arrays.
+// Shots are resolved in order; repeated or already hit cells count as misses
+// instead of costing the turn. Returns the number of ships sunk by the salvo.
+int salvo_attack(PlayerBoard *board, int shots[][2], int shot_count, int player_num, int *results) {
+    int sunk = 0;
+    
+    for (int i = 0; i < shot_count; i++) {
+        int x = shots[i][0];
+        int y = shots[i][1];
+        int result = 0;
         
-        // Print both boards
-        print_board(player1);
-        printf("\n");
-        print_board(player2);
-        
-        // Game loop
-        int current_player = 1;
-        int game_over = 0;
-        
-        while (!game_over) {
-            int attack_x, attack_y;
-            scanf("%d %d", &attack_x, &attack_y);
-            
-            int result;
-            if (current_player == 1) {
-                result = attack(player2, attack_x, attack_y, 1);
-                if (result == -1) {
-                    // Player loses turn for hitting already hit position
-                    current_player = 2;
-                    continue;
-                }
-                if (player2->ships_remaining == 0) {
-                    printf("Jucătorul 1 a câștigat!\n");
-                    game_over = 1;
-                }
-            } else {
-                result = attack(player1, attack_x, attack_y, 2);
-                if (result == -1) {
-                    // Player loses turn for hitting already hit position
-                    current_player = 1;
-                    continue;
-                }
-                if (player1->ships_remaining == 0) {
-                    printf("Jucătorul 2 a câștigat!\n");
-                    game_over = 1;
-                }
+        if (x >= 1 && x <= board->N && y >= 1 && y <= board->M && !cell_hit(board, x, y)) {
+            set_cell_hit(board, x, y);
+            patch_view(board, x, y);
+            int owner = cell_owner(board, x, y);
+            if (owner != 0) {
+                result = resolve_hit(board, owner - 1, x, y, player_num);
             }
-            
-            // Switch players
-            current_player = (current_player == 1) ? 2 : 1;
         }
         
-        // Clean up
-        destroy_board(player1);
-        destroy_board(player2);
-        
-        // Add newline between games if not the last game
-        if (game < J - 1) {
-            printf("\n");
-        }
+        if (result == 2) sunk++;
+        if (results) results[i] = result;
+    }
+    
+    return sunk;
+}
+
+// ---------------------------------------------------------------------------
+// Bitboard engine for boards up to 16 x 16. Every plane is four 64-bit words
+// (cell (x, y) is bit (x - 1) * 16 + (y - 1)), so placement checks, attacks
+// and sunk detection are bit operations on a fixed size struct.
+// ---------------------------------------------------------------------------
+
+#define SMALL_BOARD_SIZE 16
+#define SMALL_MAX_SHIPS 36  // Fleet of a full 16 x 16 board is 33 ships
+
+typedef struct {
+    uint64_t w[4];
+} Bits256;
+
+typedef struct {
+    int N, M;
+    int ship_count;
+    int ships_remaining;
+    int silent;          // Skip the hit messages
+    EventRing *events;   // Publish hits here instead of printing them
+    Bits256 occupied;
+    Bits256 hits;
+    Bits256 ship_masks[SMALL_MAX_SHIPS];
+    unsigned char owners[SMALL_BOARD_SIZE * SMALL_BOARD_SIZE];  // ship index + 1
+    char types[SMALL_MAX_SHIPS];
+    unsigned char heads[SMALL_MAX_SHIPS];  // Bit of the start coordinate
+    uint64_t destroyed;                    // One bit per ship
+} SmallBoard;
+
+static inline int small_bit(int x, int y) {
+    return (x - 1) * SMALL_BOARD_SIZE + (y - 1);
+}
+
+static inline int bits_test(const Bits256 *bits, int i) {
+    return (int)((bits->w[i >> 6] >> (i & 63)) & 1);
+}
+
+static inline void bits_set(Bits256 *bits, int i) {
+    bits->w[i >> 6] |= (uint64_t)1 << (i & 63);
+}
+
+static inline int bits_intersect(const Bits256 *a, const Bits256 *b) {
+    return ((a->w[0] & b->w[0]) | (a->w[1] & b->w[1]) |
+            (a->w[2] & b->w[2]) | (a->w[3] & b->w[3])) != 0;
+}
+
+static inline int bits_count_common(const Bits256 *a, const Bits256 *b) {
+    return __builtin_popcountll(a->w[0] & b->w[0]) + __builtin_popcountll(a->w[1] & b->w[1]) +
+           __builtin_popcountll(a->w[2] & b->w[2]) + __builtin_popcountll(a->w[3] & b->w[3]);
+}
+
+int small_board_fits(int N, int M) {
+    return N >= 1 && M >= 1 && N <= SMALL_BOARD_SIZE && M <= SMALL_BOARD_SIZE &&
+           calculate_total_ships(N, M) <= SMALL_MAX_SHIPS;
+}
+
+void init_small_board(SmallBoard *board, int N, int M, int ship_count) {
+    memset(board, 0, sizeof(SmallBoard));
+    board->N = N;
+    board->M = M;
+    board->ship_count = ship_count;
+    board->ships_remaining = ship_count;
+}
+
+// Build the mask of a ship; returns 0 if it does not fit on the board
+static int small_ship_mask(SmallBoard *board, char type, char orientation, int x, int y, Bits256 *mask) {
+    int length = get_ship_length(type);
+    if (length == 0) return 0;
+    
+    // Same bounds rules as is_valid_placement()
+    if (x < 1 || x > board->N || y < 1 || y > board->M) return 0;
+    if (orientation == 'H') {
+        if (y + length - 1 > board->M) return 0;
+    } else if (orientation == 'V') {
+        if (x - length + 1 < 1) return 0;
+    } else {
+        return 0;
+    }
+    
+    memset(mask, 0, sizeof(Bits256));
+    for (int i = 0; i < length; i++) {
+        if (orientation == 'H') bits_set(mask, small_bit(x, y + i));
+        else bits_set(mask, small_bit(x - i, y));
+    }
+    return 1;
+}
+
+int small_place_ship(SmallBoard *board, char type, char orientation, int x, int y, int ship_index) {
+    Bits256 mask;
+    if (!small_ship_mask(board, type, orientation, x, y, &mask) ||
+        bits_intersect(&mask, &board->occupied)) {
+        return 0;
+    }
+    
+    board->ship_masks[ship_index] = mask;
+    board->types[ship_index] = type;
+    board->heads[ship_index] = (unsigned char)small_bit(x, y);
+    for (int k = 0; k < 4; k++) {
+        board->occupied.w[k] |= mask.w[k];
+        uint64_t word = mask.w[k];
+        while (word) {
+            board->owners[k * 64 + __builtin_ctzll(word)] = (unsigned char)(ship_index + 1);
+            word &= word - 1;
+        }
+    }
+    return 1;
+}
+
+void small_print_board(SmallBoard *board) {
+    for (int i = 1; i <= board->N; i++) {
+        for (int j = 1; j <= board->M; j++) {
+            int owner = board->owners[small_bit(i, j)];
+            printf("%d", owner ? get_ship_length(board->types[owner - 1]) : 0);
+            if (j < board->M) printf(" ");
+        }
+        printf("\n");
+    }
+}
+
+// Same results and messages as attack()
+int small_attack(SmallBoard *board, int x, int y, int player_num) {
+    if (x < 1 || x > board->N || y < 1 || y > board->M) {
+        return 0;  // Miss (out of bounds)
+    }
+    
+    int bit = small_bit(x, y);
+    if (bits_test(&board->hits, bit)) {
+        return -1;  // Already hit, lose turn
+    }
+    bits_set(&board->hits, bit);
+    
+    int ship = board->owners[bit] - 1;
+    if (ship < 0 || (board->destroyed >> ship) & 1) {
+        return 0;  // Water or remains of a sunk ship
+    }
+    
+    // Hitting the start coordinate sinks the ship, otherwise it sinks
+    // once every cell of its mask is hit
+    if (bit == board->heads[ship] ||
+        bits_count_common(&board->ship_masks[ship], &board->hits) ==
+        get_ship_length(board->types[ship])) {
+        board->destroyed |= (uint64_t)1 << ship;
+        board->ships_remaining--;
+        report_hit(board->events, board->silent, player_num, board->types[ship], x, y,
+                   bit == board->heads[ship] ? HIT_HEAD : 2);
+        return 2;  // Ship destroyed
+    }
+    
+    report_hit(board->events, board->silent, player_num, board->types[ship], x, y, 1);
+    return 1;  // Hit but not destroyed
+}
+
+// make_attack() for the bitboard engine
+int small_make_attack(SmallBoard *board, int x, int y, AttackJournal *journal) {
+    if (journal->count == journal->capacity) {
+        journal->capacity = journal->capacity ? journal->capacity * 2 : 64;
+        journal->entries = (JournalEntry*)realloc(journal->entries,
+                                                  journal->capacity * sizeof(JournalEntry));
+    }
+    
+    JournalEntry *entry = &journal->entries[journal->count++];
+    int on_board = (x >= 1 && x <= board->N && y >= 1 && y <= board->M);
+    entry->x = x;
+    entry->y = y;
+    entry->was_hit = on_board ? bits_test(&board->hits, small_bit(x, y)) : 1;
+    entry->ship = on_board ? board->owners[small_bit(x, y)] - 1 : -1;
+    if (entry->ship >= 0) {
+        entry->destroyed = (int)((board->destroyed >> entry->ship) & 1);
+    }
+    entry->ships_remaining = board->ships_remaining;
+    
+    int silent = board->silent;
+    EventRing *events = board->events;
+    board->silent = 1;
+    board->events = NULL;
+    int result = small_attack(board, x, y, 0);
+    board->silent = silent;
+    board->events = events;
+    return result;
+}
+
+// Undo the last small_make_attack()
+void small_unmake_attack(SmallBoard *board, AttackJournal *journal) {
+    if (journal->count == 0) return;
+    
+    JournalEntry *entry = &journal->entries[--journal->count];
+    if (!entry->was_hit) {
+        int bit = small_bit(entry->x, entry->y);
+        board->hits.w[bit >> 6] &= ~((uint64_t)1 << (bit & 63));
+    }
+    if (entry->ship >= 0) {
+        board->destroyed &= ~((uint64_t)1 << entry->ship);
+        board->destroyed |= (uint64_t)entry->destroyed << entry->ship;
+    }
+    board->ships_remaining = entry->ships_remaining;
+}
+
+// ---------------------------------------------------------------------------
+// Match state machine. A match only advances when an input event arrives
+// (a placement or a shot), so the caller decides where input comes from and
+// a single thread can keep any number of matches in flight.
+// ---------------------------------------------------------------------------
+
+typedef enum {
+    PHASE_PLACEMENT,  // players are still placing ships
+    PHASE_ATTACK,     // alternating attacks
+    PHASE_FINISHED    // winner is known
+} MatchPhase;
+
+// Flags for create_match()
+#define MATCH_SALVO   1   // one shot per surviving ship each turn
+#define MATCH_GENERAL 2   // always use PlayerBoard, even for small boards
+#define MATCH_SILENT  4   // no hit messages, for replays and tools
+
+// Placed boards shared through the board cache
+typedef struct BoardLayout BoardLayout;
+void release_layout(BoardLayout *layout);
+
+typedef struct {
+    int id;
+    MatchPhase phase;
+    int ship_count;
+    PlayerBoard *players[2];  // General engine, NULL when small boards are used
+    SmallBoard *small;        // Bitboard engine for both players, or NULL
+    EventRing *events;        // Optional, receives placements, hits and the win
+    int placed[2];        // ships placed by each player
+    int current_player;
+    int winner;
+    int salvo_mode;
+    int salvo_size;       // shots expected in the current salvo
+    int salvo_count;      // shots collected so far
+    int (*salvo)[2];
+    BoardLayout *layout;  // Layout the boards were cloned from, or NULL
+} Match;
+
+Match* create_match(int id, int N, int M, int flags) {
+    int total_ships = calculate_total_ships(N, M);
+    Match *match = (Match*)calloc(1, sizeof(Match));
+    
+    match->id = id;
+    match->ship_count = total_ships;
+    if (!(flags & MATCH_GENERAL) && small_board_fits(N, M)) {
+        match->small = (SmallBoard*)malloc(2 * sizeof(SmallBoard));
+        init_small_board(&match->small[0], N, M, total_ships);
+        init_small_board(&match->small[1], N, M, total_ships);
+    } else {
+        match->players[0] = create_board(N, M, total_ships);
+        match->players[1] = create_board(N, M, total_ships);
+    }
+    for (int p = 0; p < 2; p++) {
+        if (match->small) match->small[p].silent = (flags & MATCH_SILENT) != 0;
+        else match->players[p]->silent = (flags & MATCH_SILENT) != 0;
+    }
+    match->current_player = 1;
+    match->salvo_mode = (flags & MATCH_SALVO) != 0;
+    if (match->salvo_mode) {
+        match->salvo = (int (*)[2])malloc((total_ships + 1) * sizeof(*match->salvo));
+    }
+    
+    // Boards too small for any ship skip the placement phase
+    match->phase = (total_ships == 0) ? PHASE_ATTACK : PHASE_PLACEMENT;
+    return match;
+}
+
+void destroy_match(Match *match) {
+    if (!match) return;
+    destroy_board(match->players[0]);
+    destroy_board(match->players[1]);
+    free(match->small);
+    free(match->salvo);
+    if (match->layout) release_layout(match->layout);
+    free(match);
+}
+
+// Route the events of both boards to a ring (not owned by the match)
+void match_set_events(Match *match, EventRing *events) {
+    match->events = events;
+    for (int p = 0; p < 2; p++) {
+        if (match->small) match->small[p].events = events;
+        else match->players[p]->events = events;
+    }
+}
+
+// Ships still afloat on a player's board
+int match_ships_remaining(Match *match, int player) {
+    if (match->small) return match->small[player - 1].ships_remaining;
+    return match->players[player - 1]->ships_remaining;
+}
+
+void match_print_board(Match *match, int player) {
+    if (match->small) small_print_board(&match->small[player - 1]);
+    else print_board(match->players[player - 1]);
+}
+
+// Player expected to place next when placements arrive in input order
+int match_next_placer(Match *match) {
+    return (match->placed[0] < match->ship_count) ? 1 : 2;
+}
+
+// Placement event; returns 1 if the ship was placed, 0 if it was rejected
+int match_place(Match *match, int player, char type, char orientation, int x, int y) {
+    if (match->phase != PHASE_PLACEMENT || player < 1 || player > 2) {
+        return 0;
+    }
+    
+    int *placed = &match->placed[player - 1];
+    if (*placed >= match->ship_count) {
+        return 0;
+    }
+    
+    int ok = match->small
+        ? small_place_ship(&match->small[player - 1], type, orientation, x, y, *placed)
+        : place_ship(match->players[player - 1], type, orientation, x, y, *placed);
+    if (!ok) {
+        return 0;
+    }
+    (*placed)++;
+    if (match->events) {
+        publish_event(match->events, EVENT_PLACE, player, type, 0, x, y);
+    }
+    
+    if (match->placed[0] == match->ship_count && match->placed[1] == match->ship_count) {
+        match->phase = PHASE_ATTACK;
+    }
+    return 1;
+}
+
+// Whole fleet of one player at once; see validate_fleet() for the result.
+// Returns -2 without looking at the fleet if the player cannot place one
+// now (wrong phase or player, or the fleet is already placed).
+int match_place_fleet(Match *match, int player, ShipPlacement *fleet, int count, int *errors) {
+    if (match->phase != PHASE_PLACEMENT || player < 1 || player > 2 || match->placed[player - 1] != 0) {
+        return -2;
+    }
+    
+    int invalid;
+    if (match->small) {
+        invalid = validate_fleet(match->small[0].N, match->small[0].M, fleet, count, errors);
+        if (invalid == 0 && count == match->ship_count) {
+            for (int i = 0; i < count; i++) {
+                small_place_ship(&match->small[player - 1], fleet[i].type, fleet[i].orientation,
+                                 fleet[i].x, fleet[i].y, i);
+            }
+        }
+    } else {
+        invalid = place_fleet(match->players[player - 1], fleet, count, errors);
+    }
+    if (invalid != 0 || count != match->ship_count) {
+        return invalid ? invalid : -1;
+    }
+    
+    match->placed[player - 1] = count;
+    for (int i = 0; match->events && i < count; i++) {
+        publish_event(match->events, EVENT_PLACE, player, fleet[i].type, 0, fleet[i].x, fleet[i].y);
+    }
+    if (match->placed[0] == match->ship_count && match->placed[1] == match->ship_count) {
+        match->phase = PHASE_ATTACK;
+    }
+    return 0;
+}
+
+// Shot event from the player on turn. Returns the attack() result, 0 while
+// a salvo is still being collected, or -2 if the shot is not accepted.
+int match_attack(Match *match, int player, int x, int y) {
+    if (match->phase != PHASE_ATTACK || player != match->current_player) {
+        return -2;
+    }
+    
+    int target = 3 - player;
+    int result = 0;
+    
+    if (match->salvo_mode) {
+        if (match->salvo_count == 0) {
+            match->salvo_size = match_ships_remaining(match, player);
+        }
+        match->salvo[match->salvo_count][0] = x;
+        match->salvo[match->salvo_count][1] = y;
+        if (++match->salvo_count < match->salvo_size) {
+            return 0;  // Wait for the rest of the salvo
+        }
+        if (match->small) {
+            for (int i = 0; i < match->salvo_count; i++) {
+                small_attack(&match->small[target - 1], match->salvo[i][0], match->salvo[i][1], player);
+            }
+        } else {
+            salvo_attack(match->players[target - 1], match->salvo, match->salvo_count, player, NULL);
+        }
+        match->salvo_count = 0;
+    } else if (match->small) {
+        result = small_attack(&match->small[target - 1], x, y, player);
+    } else {
+        // Hitting an already hit position just loses the turn
+        result = attack(match->players[target - 1], x, y, player);
+    }
+    
+    if (match_ships_remaining(match, target) == 0) {
+        match->winner = player;
+        match->phase = PHASE_FINISHED;
+        if (match->events) {
+            publish_event(match->events, EVENT_WIN, player, 0, 0, 0, 0);
+        }
+    }
+    
+    // Switch players
+    match->current_player = (match->current_player == 1) ? 2 : 1;
+    return result;
+}
+
+// Silent match_attack() for the player on turn that can be taken back with
+// match_unmake_attack(). Not for salvo matches. Returns -2 and records
+// nothing if the shot is not accepted.
+int match_make_attack(Match *match, int x, int y, AttackJournal *journal) {
+    if (match->phase != PHASE_ATTACK || match->salvo_mode) {
+        return -2;
+    }
+    
+    int player = match->current_player;
+    int target = 3 - player;
+    int result = match->small
+        ? small_make_attack(&match->small[target - 1], x, y, journal)
+        : make_attack(match->players[target - 1], x, y, journal);
+    
+    if (match_ships_remaining(match, target) == 0) {
+        match->winner = player;
+        match->phase = PHASE_FINISHED;
+    }
+    match->current_player = target;
+    return result;
+}
+
+// Undo the last match_make_attack(). Every accepted shot passes the turn and
+// only the last one can finish the match, so neither has to be journaled.
+void match_unmake_attack(Match *match, AttackJournal *journal) {
+    if (journal->count == 0) return;
+    
+    match->current_player = 3 - match->current_player;
+    if (match->phase == PHASE_FINISHED) {
+        match->phase = PHASE_ATTACK;
+        match->winner = 0;
+    }
+    int target = 3 - match->current_player;
+    if (match->small) small_unmake_attack(&match->small[target - 1], journal);
+    else unmake_attack(match->players[target - 1], journal);
+}
+
+// ---------------------------------------------------------------------------
+// Match server: many simultaneous matches fed from a command stream.
+//
+// Commands (one per line on stdin, or any pipe):
+//   N id N M                   create match id on an N x M board
+//   P id player type orient x y place the next ship of a player
+//   F id player k (type orient x y) x k  place a whole fleet at once
+//   A id player x y            attack the opponent of player
+//
+// Matches are sharded by id over one worker per core. Each worker owns its
+// shard and drains a lock-free MPSC queue, so any number of producer threads
+// can submit commands while the boards themselves are never shared.
+// ---------------------------------------------------------------------------
+
+typedef struct Command {
+    struct Command *_Atomic next;
+    char op;
+    int match_id;
+    int player;
+    int a, b;           // N M for 'N', x y for 'P' and 'A'
+    char type, orientation;
+    int fleet_size;     // Ships of an 'F' command
+    ShipPlacement *fleet;
+} Command;
+
+// Vyukov intrusive MPSC queue
+typedef struct {
+    Command *_Atomic tail;  // producers append here
+    Command *head;          // consumer side, owned by the worker
+    Command stub;
+} CommandQueue;
+
+// Open addressing table of the matches owned by one worker
+typedef struct {
+    Match **slots;
+    int capacity;
+    int count;          // Live matches and tombstones
+} MatchTable;
+
+// Slot of a finished match, so probes keep going past it. Ids are never
+// negative, so it matches no lookup.
+static Match match_tombstone = {.id = -1};
+
+typedef struct MatchServer MatchServer;
+
+typedef struct {
+    CommandQueue queue;
+    MatchTable matches;
+    MatchServer *server;
+    pthread_t thread;
+} Shard;
+
+struct MatchServer {
+    Shard *shards;
+    int shard_count;
+    atomic_int stopping;
+};
+
+static void queue_init(CommandQueue *queue) {
+    atomic_store(&queue->stub.next, NULL);
+    atomic_store(&queue->tail, &queue->stub);
+    queue->head = &queue->stub;
+}
+
+// Safe to call from any thread
+static void queue_push(CommandQueue *queue, Command *cmd) {
+    atomic_store_explicit(&cmd->next, NULL, memory_order_relaxed);
+    Command *prev = atomic_exchange_explicit(&queue->tail, cmd, memory_order_acq_rel);
+    atomic_store_explicit(&prev->next, cmd, memory_order_release);
+}
+
+// Only called by the owning worker; returns NULL when empty
+static Command* queue_pop(CommandQueue *queue) {
+    Command *head = queue->head;
+    Command *next = atomic_load_explicit(&head->next, memory_order_acquire);
+    
+    if (head == &queue->stub) {
+        if (!next) return NULL;
+        queue->head = next;
+        head = next;
+        next = atomic_load_explicit(&head->next, memory_order_acquire);
+    }
+    if (next) {
+        queue->head = next;
+        return head;
+    }
+    if (head != atomic_load_explicit(&queue->tail, memory_order_acquire)) {
+        return NULL;  // A producer is halfway through a push
+    }
+    queue_push(queue, &queue->stub);
+    next = atomic_load_explicit(&head->next, memory_order_acquire);
+    if (next) {
+        queue->head = next;
+        return head;
+    }
+    return NULL;
+}
+
+static Match** match_slot(MatchTable *table, int id) {
+    unsigned int i = ((unsigned int)id * 2654435761u) & (table->capacity - 1);
+    while (table->slots[i] && table->slots[i]->id != id) {
+        i = (i + 1) & (table->capacity - 1);
+    }
+    return &table->slots[i];
+}
+
+// Rehash without the tombstones, doubling only if live matches need it
+static void match_table_grow(MatchTable *table) {
+    Match **old = table->slots;
+    int old_capacity = table->capacity;
+    int live = 0;
+    
+    for (int i = 0; i < old_capacity; i++) {
+        if (old[i] && old[i] != &match_tombstone) live++;
+    }
+    table->capacity = !old_capacity ? 64 : (live * 4 < old_capacity) ? old_capacity : old_capacity * 2;
+    table->slots = (Match**)calloc(table->capacity, sizeof(Match*));
+    table->count = live;
+    for (int i = 0; i < old_capacity; i++) {
+        if (old[i] && old[i] != &match_tombstone) *match_slot(table, old[i]->id) = old[i];
+    }
+    free(old);
+}
+
+// Run one command against the shard that owns its match
+static void shard_execute(Shard *shard, Command *cmd) {
+    MatchTable *table = &shard->matches;
+    
+    if (cmd->op == 'N') {
+        if (table->count * 2 >= table->capacity) {
+            match_table_grow(table);
+        }
+        Match **slot = match_slot(table, cmd->match_id);
+        if (*slot || cmd->a < 1 || cmd->b < 1) {
+            printf("Meciul %d: eroare la creare.\n", cmd->match_id);
+            return;
+        }
+        *slot = create_match(cmd->match_id, cmd->a, cmd->b, 0);
+        table->count++;
+        return;
+    }
+    
+    Match *match = table->capacity ? *match_slot(table, cmd->match_id) : NULL;
+    if (!match) {
+        printf("Meciul %d: comandă invalidă.\n", cmd->match_id);
+        return;
+    }
+    
+    if (cmd->op == 'P') {
+        if (!match_place(match, cmd->player, cmd->type, cmd->orientation, cmd->a, cmd->b)) {
+            printf("Meciul %d: Eroare: navă invalidă. Încercați din nou.\n", cmd->match_id);
+        }
+        return;
+    }
+    
+    if (cmd->op == 'F') {
+        int *errors = (int*)malloc((cmd->fleet_size + 1) * sizeof(int));
+        static const char *reasons[] = {"", "poziție", "cotă", "suprapunere"};
+        int invalid = errors ? match_place_fleet(match, cmd->player, cmd->fleet, cmd->fleet_size, errors) : -2;
+        
+        if (invalid == -2) {
+            printf("Meciul %d: comandă invalidă.\n", cmd->match_id);
+        } else if (invalid == -1) {
+            printf("Meciul %d: flotă incompletă.\n", cmd->match_id);
+        } else {
+            for (int i = 0; i < cmd->fleet_size; i++) {
+                if (errors[i] != FLEET_OK) {
+                    printf("Meciul %d: nava %d invalidă (%s).\n", cmd->match_id, i + 1, reasons[errors[i]]);
+                }
+            }
+        }
+        free(errors);
+        return;
+    }
+    
+    if (match_attack(match, cmd->player, cmd->a, cmd->b) == -2) {
+        printf("Meciul %d: comandă invalidă.\n", cmd->match_id);
+        return;
+    }
+    if (match->phase == PHASE_FINISHED) {
+        printf("Meciul %d: Jucătorul %d a câștigat!\n", cmd->match_id, match->winner);
+        // Free it right away; later commands for the id are invalid until
+        // an N command reuses it
+        *match_slot(table, cmd->match_id) = &match_tombstone;
+        destroy_match(match);
+    }
+}
+
+static void* shard_worker(void *arg) {
+    Shard *shard = (Shard*)arg;
+    int idle = 0;
+    
+    while (1) {
+        Command *cmd = queue_pop(&shard->queue);
+        if (!cmd) {
+            if (atomic_load(&shard->server->stopping)) {
+                // Everything pushed before stopping is visible now
+                cmd = queue_pop(&shard->queue);
+                if (!cmd) break;
+            } else {
+                // Back off gradually while the queue is empty
+                if (++idle < 64) sched_yield();
+                else usleep(100);
+                continue;
+            }
+        }
+        idle = 0;
+        shard_execute(shard, cmd);
+        free(cmd->fleet);
+        free(cmd);
+    }
+    
+    return NULL;
+}
+
+MatchServer* server_start(int shard_count) {
+    MatchServer *server = (MatchServer*)malloc(sizeof(MatchServer));
+    server->shard_count = shard_count;
+    server->shards = (Shard*)calloc(shard_count, sizeof(Shard));
+    atomic_store(&server->stopping, 0);
+    
+    for (int i = 0; i < shard_count; i++) {
+        queue_init(&server->shards[i].queue);
+        server->shards[i].server = server;
+        pthread_create(&server->shards[i].thread, NULL, shard_worker, &server->shards[i]);
+    }
+    
+    return server;
+}
+
+// Route a command to the shard owning its match; takes ownership of cmd
+void server_submit(MatchServer *server, Command *cmd) {
+    unsigned int shard = (unsigned int)cmd->match_id % (unsigned int)server->shard_count;
+    queue_push(&server->shards[shard].queue, cmd);
+}
+
+// Drain all queues, join the workers and free every match
+void server_stop(MatchServer *server) {
+    atomic_store(&server->stopping, 1);
+    
+    for (int i = 0; i < server->shard_count; i++) {
+        Shard *shard = &server->shards[i];
+        pthread_join(shard->thread, NULL);
+        for (int j = 0; j < shard->matches.capacity; j++) {
+            Match *match = shard->matches.slots[j];
+            if (match && match != &match_tombstone) destroy_match(match);
+        }
+        free(shard->matches.slots);
+    }
+    
+    free(server->shards);
+    free(server);
+}
+
+// Parse one command line; returns NULL if it is malformed
+Command* parse_command(const char *line) {
+    Command *cmd = (Command*)calloc(1, sizeof(Command));
+    int ok = 0;
+    
+    switch (line[0]) {
+        case 'N':
+            ok = sscanf(line + 1, "%d %d %d", &cmd->match_id, &cmd->a, &cmd->b) == 3;
+            break;
+        case 'P':
+            ok = sscanf(line + 1, "%d %d %c %c %d %d", &cmd->match_id, &cmd->player,
+                        &cmd->type, &cmd->orientation, &cmd->a, &cmd->b) == 6;
+            break;
+        case 'A':
+            ok = sscanf(line + 1, "%d %d %d %d", &cmd->match_id, &cmd->player,
+                        &cmd->a, &cmd->b) == 4;
+            break;
+        case 'F': {
+            int used;
+            ok = sscanf(line + 1, "%d %d %d%n", &cmd->match_id, &cmd->player,
+                        &cmd->fleet_size, &used) == 3 && cmd->fleet_size >= 0;
+            if (!ok) break;
+            
+            // A ship takes at least five characters ("SH1 1"), so a count
+            // the rest of the line cannot hold is rejected before anything
+            // is allocated for it
+            const char *p = line + 1 + used;
+            ok = cmd->fleet_size <= (int)(strlen(p) / 5);
+            if (!ok) break;
+            cmd->fleet = (ShipPlacement*)malloc((cmd->fleet_size + 1) * sizeof(ShipPlacement));
+            ok = cmd->fleet != NULL;
+            for (int i = 0; i < cmd->fleet_size && ok; i++) {
+                ShipPlacement *ship = &cmd->fleet[i];
+                ok = sscanf(p, " %c %c %d %d%n", &ship->type, &ship->orientation,
+                            &ship->x, &ship->y, &used) == 4;
+                p += used;
+            }
+            break;
+        }
+    }
+    
+    if (!ok || cmd->match_id < 0) {
+        free(cmd->fleet);
+        free(cmd);
+        return NULL;
+    }
+    cmd->op = line[0];
+    return cmd;
+}
+
+// Pipe front end: read commands from stdin until EOF
+int run_server(int shard_count) {
+    if (shard_count < 1) {
+        shard_count = (int)sysconf(_SC_NPROCESSORS_ONLN);
+        if (shard_count < 1) shard_count = 1;
+    }
+    
+    MatchServer *server = server_start(shard_count);
+    char *line = NULL;
+    size_t line_size = 0;
+    
+    // Fleet commands can be long, so lines are not length limited
+    while (getline(&line, &line_size, stdin) != -1) {
+        Command *cmd = parse_command(line);
+        if (cmd) server_submit(server, cmd);
+    }
+    
+    free(line);
+    server_stop(server);
+    return 0;
+}
+
+// ---------------------------------------------------------------------------
+// Monte Carlo win probability for a game in progress. Each shot is recorded
+// in an Observation as it was reported to the shooter (water, hit, or sink
+// of a given type); samples then draw hidden fleets consistent with it and
+// play them out.
+// ---------------------------------------------------------------------------
+
+#define CELL_UNKNOWN 0
+#define CELL_MISS    1
+#define CELL_HIT     2
+
+typedef struct {
+    int N, M;
+    unsigned char *cells;   // N * M cells as seen by the shooter
+    int hit_count;
+    int sunk[5];            // Sinks reported, per type (S Y B L A)
+} Observation;
+
+typedef struct {
+    Observation boards[2];  // boards[p] is player p + 1's board
+    int current_player;
+    uint64_t seed;
+    long long samples;
+    long long wins[2];
+    long long rejected;
+} Estimate;
+
+// Counter based stream: draw k of stream s is a pure function of (s, k), so a
+// sample gives the same result on whatever thread runs it
+typedef struct {
+    uint64_t key;
+    uint64_t counter;
+} RngStream;
+
+static inline uint64_t mix64(uint64_t z) {
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+static inline uint32_t rng_below(RngStream *rng, uint32_t bound) {
+    uint64_t r = mix64(rng->key + 0x9E3779B97F4A7C15ULL * ++rng->counter);
+    return (uint32_t)(((r >> 32) * bound) >> 32);
+}
+
+void init_observation(Observation *obs, int N, int M) {
+    memset(obs, 0, sizeof(Observation));
+    obs->N = N;
+    obs->M = M;
+    obs->cells = (unsigned char*)calloc((size_t)N * M, 1);
+}
+
+// Record a shot of player at the other board as the match_attack() result
+// reported it. Remains of a sunk ship were reported as water, so they are
+// misses here even though a ship lies under them.
+void observe_attack(Match *match, Observation *obs, int player, int x, int y, int result) {
+    if (result < 0 || x < 1 || x > obs->N || y < 1 || y > obs->M) return;
+    size_t c = (size_t)(x - 1) * obs->M + (y - 1);
+    if (result == 0) {
+        obs->cells[c] = CELL_MISS;
+        return;
+    }
+    obs->cells[c] = CELL_HIT;
+    obs->hit_count++;
+    
+    if (result == 2) {
+        // The hit message names the type of the ship
+        int target = 3 - player;
+        char type;
+        if (match->small) {
+            SmallBoard *small = &match->small[target - 1];
+            type = small->types[small->owners[small_bit(x, y)] - 1];
+        } else {
+            PlayerBoard *board = match->players[target - 1];
+            type = board->fleet.types[cell_owner(board, x, y) - 1];
+        }
+        obs->sunk[type_index(type)]++;
+    }
+}
+
+// Draw a fleet that fits the observation into fleet (ship id + 1 per cell).
+// Returns 0 if the draw contradicts it and has to be rejected.
+static int sample_fleet(Observation *obs, RngStream *rng, unsigned short *fleet,
+                        unsigned char *heads, int *lengths) {
+    static const char types[] = {'S', 'Y', 'B', 'L', 'A'};
+    int N = obs->N, M = obs->M;
+    int ship = 0;
+    int type_first[6];      // Ships of type t are [type_first[t], type_first[t + 1])
+    
+    memset(fleet, 0, (size_t)N * M * sizeof(unsigned short));
+    memset(heads, 0, (size_t)N * M);
+    
+    for (int t = 0; t < 5; t++) {
+        int length = get_ship_length(types[t]);
+        int count = calculate_ships_per_type(N, M, types[t]);
+        
+        type_first[t] = ship;
+        for (int k = 0; k < count; k++, ship++) {
+            int placed = 0;
+            for (int attempt = 0; attempt < 64 && !placed; attempt++) {
+                int horizontal = rng_below(rng, 2);
+                int x = 1 + (int)rng_below(rng, (uint32_t)N);
+                int y = 1 + (int)rng_below(rng, (uint32_t)M);
+                int dx = horizontal ? 0 : -1;
+                int dy = horizontal ? 1 : 0;
+                
+                if (x + dx * (length - 1) < 1 || y + dy * (length - 1) > M) continue;
+                placed = 1;
+                for (int i = 0; i < length && placed; i++) {
+                    size_t c = (size_t)(x + dx * i - 1) * M + (y + dy * i - 1);
+                    if (fleet[c] || obs->cells[c] == CELL_MISS) placed = 0;
+                }
+                if (!placed) continue;
+                for (int i = 0; i < length; i++) {
+                    fleet[(size_t)(x + dx * i - 1) * M + (y + dy * i - 1)] = (unsigned short)(ship + 1);
+                }
+                heads[(size_t)(x - 1) * M + (y - 1)] = 1;
+            }
+            if (!placed) return 0;
+            lengths[ship] = length;
+        }
+    }
+    
+    type_first[5] = ship;
+    
+    // Every observed hit must land on a ship, and the ships the hits sink
+    // must match the sinks reported for each type
+    int covered = 0;
+    for (size_t c = 0; c < (size_t)N * M; c++) {
+        int hit_ship = fleet[c] - 1;
+        if (obs->cells[c] != CELL_HIT || hit_ship < 0) continue;
+        covered++;
+        if (lengths[hit_ship] > 0) lengths[hit_ship] = heads[c] ? 0 : lengths[hit_ship] - 1;
+    }
+    
+    int consistent = covered == obs->hit_count;
+    for (int t = 0; t < 5; t++) {
+        int sunk = 0;
+        for (int k = type_first[t]; k < type_first[t + 1]; k++) {
+            if (lengths[k] == 0) sunk++;
+            lengths[k] = get_ship_length(types[t]);
+        }
+        if (sunk != obs->sunk[t]) consistent = 0;
+    }
+    return consistent;
+}
+
+// Shots a random shooter needs to sink the sampled fleet, head hits included
+static long long play_out(Observation *obs, RngStream *rng, unsigned short *fleet,
+                          unsigned char *heads, int *lengths, int ship_count, int *order) {
+    size_t cells = (size_t)obs->N * obs->M;
+    int alive = ship_count;
+    int unknown = 0;
+    
+    // Apply what the shooter already hit
+    for (size_t c = 0; c < cells; c++) {
+        int ship = fleet[c] - 1;
+        if (obs->cells[c] == CELL_UNKNOWN) {
+            order[unknown++] = (int)c;
+        } else if (ship >= 0 && lengths[ship] > 0) {
+            lengths[ship] = heads[c] ? 0 : lengths[ship] - 1;
+            if (lengths[ship] == 0) alive--;
+        }
+    }
+    
+    // Shoot the unknown cells in random order
+    long long shots = 0;
+    for (int i = 0; i < unknown && alive > 0; i++) {
+        int j = i + (int)rng_below(rng, (uint32_t)(unknown - i));
+        int c = order[j];
+        order[j] = order[i];
+        shots++;
+        
+        int ship = fleet[c] - 1;
+        if (ship >= 0 && lengths[ship] > 0) {
+            lengths[ship] = heads[c] ? 0 : lengths[ship] - 1;
+            if (lengths[ship] == 0) alive--;
+        }
+    }
+    return shots;
+}
+
+typedef struct {
+    Estimate *estimate;
+    long long first, count;  // Sample range of this thread
+    long long wins[2];
+    long long rejected;
+} EstimateTask;
+
+static void* estimate_worker(void *arg) {
+    EstimateTask *task = (EstimateTask*)arg;
+    Estimate *estimate = task->estimate;
+    int ship_count = calculate_total_ships(estimate->boards[0].N, estimate->boards[0].M);
+    size_t cells = (size_t)estimate->boards[0].N * estimate->boards[0].M;
+    
+    unsigned short *fleet = (unsigned short*)malloc(cells * sizeof(unsigned short));
+    unsigned char *heads = (unsigned char*)malloc(cells);
+    int *order = (int*)malloc(cells * sizeof(int));
+    int *lengths = (int*)malloc((ship_count + 1) * sizeof(int));
+    
+    for (long long i = task->first; i < task->first + task->count; i++) {
+        RngStream rng = {mix64(estimate->seed ^ mix64((uint64_t)i)), 0};
+        long long shots[2];
+        int ok = 1;
+        
+        // shots[p]: shots player p + 1 needs against the other board
+        for (int p = 0; p < 2 && ok; p++) {
+            Observation *obs = &estimate->boards[1 - p];
+            int tries = 0;
+            while (!sample_fleet(obs, &rng, fleet, heads, lengths)) {
+                task->rejected++;
+                if (++tries == 1000) { ok = 0; break; }
+            }
+            if (ok) shots[p] = play_out(obs, &rng, fleet, heads, lengths, ship_count, order);
+        }
+        if (!ok) continue;
+        
+        // The player on turn wins ties since it shoots first
+        int first = estimate->current_player - 1;
+        if (shots[first] <= shots[1 - first]) task->wins[first]++;
+        else task->wins[1 - first]++;
+    }
+    
+    free(fleet);
+    free(heads);
+    free(order);
+    free(lengths);
+    return NULL;
+}
+
+// Run samples [first, first + count) on thread_count threads
+void run_estimate(Estimate *estimate, long long first, long long count, int thread_count) {
+    pthread_t *threads = (pthread_t*)malloc(thread_count * sizeof(pthread_t));
+    EstimateTask *tasks = (EstimateTask*)calloc(thread_count, sizeof(EstimateTask));
+    
+    for (int t = 0; t < thread_count; t++) {
+        tasks[t].estimate = estimate;
+        tasks[t].first = first + count * t / thread_count;
+        tasks[t].count = first + count * (t + 1) / thread_count - tasks[t].first;
+        pthread_create(&threads[t], NULL, estimate_worker, &tasks[t]);
+    }
+    for (int t = 0; t < thread_count; t++) {
+        pthread_join(threads[t], NULL);
+        estimate->wins[0] += tasks[t].wins[0];
+        estimate->wins[1] += tasks[t].wins[1];
+        estimate->rejected += tasks[t].rejected;
+    }
+    estimate->samples += count;
+    
+    free(threads);
+    free(tasks);
+}
+
+// Read one game from stdin up to EOF, then estimate both win probabilities,
+// doubling the sample count up to the requested total
+int run_estimator(long long samples, int thread_count) {
+    if (thread_count < 1) {
+        thread_count = (int)sysconf(_SC_NPROCESSORS_ONLN);
+        if (thread_count < 1) thread_count = 1;
+    }
+    
+    int J, N, M;
+    if (scanf("%d %d %d", &J, &N, &M) != 3) return 1;
+    
+    Match *match = create_match(0, N, M, 0);
+    Estimate estimate;
+    memset(&estimate, 0, sizeof(estimate));
+    init_observation(&estimate.boards[0], N, M);
+    init_observation(&estimate.boards[1], N, M);
+    
+    char type, orientation;
+    int x, y;
+    while (match->phase == PHASE_PLACEMENT &&
+           scanf(" %c %c %d %d", &type, &orientation, &x, &y) == 4) {
+        if (!match_place(match, match_next_placer(match), type, orientation, x, y)) {
+            printf("Eroare: navă invalidă. Încercați din nou.\n");
+        }
+    }
+    while (match->phase == PHASE_ATTACK && scanf("%d %d", &x, &y) == 2) {
+        int player = match->current_player;
+        int result = match_attack(match, player, x, y);
+        observe_attack(match, &estimate.boards[2 - player], player, x, y, result);
+    }
+    if (match->phase != PHASE_ATTACK) {
+        printf("Jocul nu este în desfășurare.\n");
+        free(estimate.boards[0].cells);
+        free(estimate.boards[1].cells);
+        destroy_match(match);
+        return 1;
+    }
+    
+    estimate.current_player = match->current_player;
+    estimate.seed = 0x5EED;
+    destroy_match(match);  // The samples only use the observations
+    
+    struct timespec start, now;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    
+    for (long long batch = 1000; estimate.samples < samples; batch *= 2) {
+        if (batch > samples - estimate.samples) batch = samples - estimate.samples;
+        run_estimate(&estimate, estimate.samples, batch, thread_count);
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        
+        long long played = estimate.wins[0] + estimate.wins[1];
+        double seconds = (now.tv_sec - start.tv_sec) + (now.tv_nsec - start.tv_nsec) / 1e9;
+        printf("%lld eșantioane, %.3f s: jucătorul 1 %.4f, jucătorul 2 %.4f (%lld respinse)\n",
+               estimate.samples, seconds,
+               played ? (double)estimate.wins[0] / played : 0.0,
+               played ? (double)estimate.wins[1] / played : 0.0,
+               estimate.rejected);
+    }
+    
+    free(estimate.boards[0].cells);
+    free(estimate.boards[1].cells);
+    return 0;
+}
+
+// ---------------------------------------------------------------------------
+// Compressed game archive. Text input in the usual format is replayed
+// silently to find where each game ends, then stored as:
+//
+//   "BSA1" zz(J), the number of games stored. It is written before any
+//          game is read, as the count announced by the text input, and is
+//          patched to the stored count at the end when the output can seek.
+//          Patched counts are padded to the same number of bytes.
+//   blocks of ARCHIVE_BLOCK_GAMES games, each game being
+//     zz(N) zz(M) varint(placements) placement... varint(attacks) attack...
+//     placement: code byte (type 0-4 = S Y B L A, 7 = raw char follows;
+//                orientation << 3, 0 = H, 1 = V, 3 = raw char follows)
+//                [raw type] [raw orientation] zz(x) zz(y)
+//     attack:    zz(dx) zz(dy) against the previous shot of the same player
+//   index: varint(games) varint(blocks) varint(block offset deltas)...
+//          games is the count actually stored, which is less than an
+//          unpatched J if the text input was cut short
+//   trailer: 8 byte little endian index offset, "BSAI"
+//
+// zz() is a zig-zag varint, so small deltas of either sign take one byte.
+// The index lets a reader seek straight to the block holding a game.
+// ---------------------------------------------------------------------------
+
+#define ARCHIVE_BLOCK_GAMES 64
+
+// Output stream that counts its own offset, ftell() does not work on pipes
+typedef struct {
+    FILE *out;
+    long offset;
+} ArchiveWriter;
+
+static inline void put_byte(ArchiveWriter *writer, int byte) {
+    putc_unlocked(byte, writer->out);
+    writer->offset++;
+}
+
+static inline void put_varint(ArchiveWriter *writer, uint64_t value) {
+    while (value >= 0x80) {
+        put_byte(writer, (int)(value & 0x7F) | 0x80);
+        value >>= 7;
+    }
+    put_byte(writer, (int)value);
+}
+
+static inline void put_zigzag(ArchiveWriter *writer, long long value) {
+    put_varint(writer, ((uint64_t)value << 1) ^ (uint64_t)(value >> 63));
+}
+
+static inline int get_varint(FILE *in, uint64_t *value) {
+    uint64_t result = 0;
+    int shift = 0;
+    int c;
+    
+    do {
+        c = getc_unlocked(in);
+        if (c == EOF || shift > 63) return 0;
+        result |= (uint64_t)(c & 0x7F) << shift;
+        shift += 7;
+    } while (c & 0x80);
+    
+    *value = result;
+    return 1;
+}
+
+static inline int get_zigzag(FILE *in, long long *value) {
+    uint64_t raw;
+    if (!get_varint(in, &raw)) return 0;
+    *value = (long long)(raw >> 1) ^ -(long long)(raw & 1);
+    return 1;
+}
+
+// Minimal token reader over stdio, faster than scanf for big inputs
+static int read_int(FILE *in, int *value) {
+    int c = getc_unlocked(in);
+    while (c != EOF && isspace(c)) c = getc_unlocked(in);
+    
+    int negative = (c == '-');
+    if (c == '-' || c == '+') c = getc_unlocked(in);
+    if (c == EOF || !isdigit(c)) return 0;
+    
+    long long result = 0;
+    while (c != EOF && isdigit(c)) {
+        if (result < 1000000000000LL) result = result * 10 + (c - '0');
+        c = getc_unlocked(in);
+    }
+    if (c != EOF) ungetc(c, in);
+    *value = (int)(negative ? -result : result);
+    return 1;
+}
+
+static int read_char(FILE *in, char *value) {
+    int c = getc_unlocked(in);
+    while (c != EOF && isspace(c)) c = getc_unlocked(in);
+    if (c == EOF) return 0;
+    *value = (char)c;
+    return 1;
+}
+
+static inline void write_int(FILE *out, long long value) {
+    char digits[24];
+    int n = 0;
+    uint64_t v = (value < 0) ? (uint64_t)(-(value + 1)) + 1 : (uint64_t)value;
+    
+    if (value < 0) putc_unlocked('-', out);
+    do {
+        digits[n++] = (char)('0' + v % 10);
+        v /= 10;
+    } while (v);
+    while (n) putc_unlocked(digits[--n], out);
+}
+
+typedef struct {
+    char type, orientation;
+    int x, y;
+} PlacementRecord;
+
+// One game as it appeared in the text input
+typedef struct {
+    int N, M;
+    PlacementRecord *placements;  // Every placement line, rejected ones included
+    int placement_count;
+    int placement_capacity;
+    int (*attacks)[2];
+    long attack_count;
+    long attack_capacity;
+    // Filled by read_game_outcomes() only
+    unsigned char *outcomes;      // OUTCOME() of each attack
+    long outcome_capacity;
+    int placed[5];                // Ships of each type in both fleets
+    int finished;
+} GameRecord;
+
+// What an attack hit: 0 if no ship, else the type index + 1 and the event
+// result (1, 2 or HIT_HEAD)
+#define OUTCOME(type, result) ((unsigned char)(((type) + 1) | ((result) << 3)))
+#define OUTCOME_TYPE(outcome) (((outcome) & 7) - 1)
+#define OUTCOME_RESULT(outcome) ((outcome) >> 3)
+
+void free_game_record(GameRecord *game) {
+    free(game->placements);
+    free(game->attacks);
+    free(game->outcomes);
+    memset(game, 0, sizeof(GameRecord));
+}
+
+// Read the next text game, replaying it silently to know where its attacks
+// end. The record's buffers are reused between calls. Returns 0 at the end.
+int read_game(FILE *in, int id, GameRecord *game) {
+    if (!read_int(in, &game->N) || !read_int(in, &game->M) || game->N < 1 || game->M < 1) {
+        return 0;
+    }
+    
+    Match *match = create_match(id, game->N, game->M, MATCH_SILENT);
+    game->placement_count = 0;
+    game->attack_count = 0;
+    
+    PlacementRecord record;
+    while (match->phase == PHASE_PLACEMENT &&
+           read_char(in, &record.type) && read_char(in, &record.orientation) &&
+           read_int(in, &record.x) && read_int(in, &record.y)) {
+        if (game->placement_count == game->placement_capacity) {
+            game->placement_capacity = game->placement_capacity ? game->placement_capacity * 2 : 256;
+            game->placements = (PlacementRecord*)realloc(game->placements,
+                                                         game->placement_capacity * sizeof(PlacementRecord));
+        }
+        game->placements[game->placement_count++] = record;
+        match_place(match, match_next_placer(match), record.type, record.orientation, record.x, record.y);
+    }
+    
+    int x, y;
+    while (match->phase == PHASE_ATTACK && read_int(in, &x) && read_int(in, &y)) {
+        if (game->attack_count == game->attack_capacity) {
+            game->attack_capacity = game->attack_capacity ? game->attack_capacity * 2 : 1024;
+            game->attacks = (int (*)[2])realloc(game->attacks, game->attack_capacity * sizeof(*game->attacks));
+        }
+        game->attacks[game->attack_count][0] = x;
+        game->attacks[game->attack_count][1] = y;
+        game->attack_count++;
+        match_attack(match, match->current_player, x, y);
+    }
+    
+    destroy_match(match);
+    return 1;
+}
+
+// Encode text games from in; returns the number of games stored
+long archive_games(FILE *in, FILE *out) {
+    int J;
+    if (!read_int(in, &J)) return 0;
+    
+    ArchiveWriter writer = {out, 0};
+    long start = ftell(out);
+    for (int i = 0; i < 4; i++) put_byte(&writer, "BSA1"[i]);
+    put_zigzag(&writer, J);
+    long header_end = writer.offset;
+    
+    long *block_offsets = NULL;
+    long block_count = 0;
+    long games = 0;
+    GameRecord record;
+    memset(&record, 0, sizeof(record));
+    
+    for (int game = 0; game < J; game++) {
+        if (!read_game(in, game, &record)) break;
+        
+        int N = record.N, M = record.M;
+        PlacementRecord *placements = record.placements;
+        int placement_count = record.placement_count;
+        int (*attacks)[2] = record.attacks;
+        long attack_count = record.attack_count;
+        
+        if (games % ARCHIVE_BLOCK_GAMES == 0) {
+            block_offsets = (long*)realloc(block_offsets, (block_count + 1) * sizeof(long));
+            block_offsets[block_count++] = writer.offset;
+        }
+        games++;
+        
+        put_zigzag(&writer, N);
+        put_zigzag(&writer, M);
+        put_varint(&writer, (uint64_t)placement_count);
+        for (int i = 0; i < placement_count; i++) {
+            static const char types[] = "SYBLA";
+            const char *t = strchr(types, placements[i].type);
+            int type_code = (placements[i].type && t) ? (int)(t - types) : 7;
+            int orientation_code = placements[i].orientation == 'H' ? 0 :
+                                   placements[i].orientation == 'V' ? 1 : 3;
+            
+            put_byte(&writer, type_code | (orientation_code << 3));
+            if (type_code == 7) put_byte(&writer, placements[i].type);
+            if (orientation_code == 3) put_byte(&writer, placements[i].orientation);
+            put_zigzag(&writer, placements[i].x);
+            put_zigzag(&writer, placements[i].y);
+        }
+        
+        put_varint(&writer, (uint64_t)attack_count);
+        int previous[2][2] = {{0, 0}, {0, 0}};
+        for (long i = 0; i < attack_count; i++) {
+            int *last = previous[i & 1];
+            put_zigzag(&writer, (long long)attacks[i][0] - last[0]);
+            put_zigzag(&writer, (long long)attacks[i][1] - last[1]);
+            last[0] = attacks[i][0];
+            last[1] = attacks[i][1];
+        }
+    }
+    
+    // Block index and trailer
+    long index_offset = writer.offset;
+    put_varint(&writer, (uint64_t)games);
+    put_varint(&writer, (uint64_t)block_count);
+    for (long i = 0; i < block_count; i++) {
+        put_varint(&writer, (uint64_t)(block_offsets[i] - (i ? block_offsets[i - 1] : 0)));
+    }
+    for (int i = 0; i < 8; i++) {
+        put_byte(&writer, (int)(((uint64_t)index_offset >> (8 * i)) & 0xFF));
+    }
+    for (int i = 0; i < 4; i++) put_byte(&writer, "BSAI"[i]);
+    
+    // Put the stored count in the header, so that a reader that cannot seek
+    // to the index still announces the right number of games. Appending
+    // streams would write it at the end instead.
+    int flags = fcntl(fileno(out), F_GETFL);
+    if (games != J && start >= 0 && flags >= 0 && !(flags & O_APPEND) && fseek(out, start + 4, SEEK_SET) == 0) {
+        uint64_t value = (uint64_t)games << 1;
+        for (long i = 5; i < header_end; i++) {
+            putc_unlocked((int)(value & 0x7F) | 0x80, out);
+            value >>= 7;
+        }
+        putc_unlocked((int)value, out);
+        fseek(out, 0, SEEK_END);
+    }
+    
+    free(block_offsets);
+    free_game_record(&record);
+    return games;
+}
+
+// Decode one game back to text; a NULL out skips it
+static int unarchive_game(FILE *in, FILE *out) {
+    long long N, M, x, y;
+    uint64_t placement_count, attack_count;
+    
+    if (!get_zigzag(in, &N) || !get_zigzag(in, &M) || !get_varint(in, &placement_count)) return 0;
+    if (out) {
+        write_int(out, N);
+        putc_unlocked(' ', out);
+        write_int(out, M);
+        putc_unlocked('\n', out);
+    }
+    
+    for (uint64_t i = 0; i < placement_count; i++) {
+        static const char types[] = "SYBLA";
+        int code = getc_unlocked(in);
+        if (code == EOF) return 0;
+        
+        int type = ((code & 7) == 7) ? getc_unlocked(in) : types[code & 7];
+        int orientation = ((code >> 3) == 3) ? getc_unlocked(in) : ((code >> 3) ? 'V' : 'H');
+        if (!get_zigzag(in, &x) || !get_zigzag(in, &y)) return 0;
+        if (!out) continue;
+        
+        putc_unlocked(type, out);
+        putc_unlocked(' ', out);
+        putc_unlocked(orientation, out);
+        putc_unlocked(' ', out);
+        write_int(out, x);
+        putc_unlocked(' ', out);
+        write_int(out, y);
+        putc_unlocked('\n', out);
+    }
+    
+    if (!get_varint(in, &attack_count)) return 0;
+    long long previous[2][2] = {{0, 0}, {0, 0}};
+    for (uint64_t i = 0; i < attack_count; i++) {
+        long long *last = previous[i & 1];
+        long long dx, dy;
+        if (!get_zigzag(in, &dx) || !get_zigzag(in, &dy)) return 0;
+        last[0] += dx;
+        last[1] += dy;
+        if (!out) continue;
+        write_int(out, last[0]);
+        putc_unlocked(' ', out);
+        write_int(out, last[1]);
+        putc_unlocked('\n', out);
+    }
+    return 1;
+}
+
+// Decode games [first, first + count) to text; count < 0 means all. With a
+// seekable archive the index gives the number of stored games and is used
+// to jump to the right block. Otherwise the games are streamed from the
+// start and the count printed ahead of them comes from the header, which
+// only overstates it if the archive was written to a pipe from cut input,
+// or was cut itself.
+long unarchive_games(FILE *in, FILE *out, long first, long count) {
+    char magic[4];
+    long long J;
+    if (fread(magic, 1, 4, in) != 4 || memcmp(magic, "BSA1", 4) != 0 || !get_zigzag(in, &J)) {
+        return -1;
+    }
+    if (first < 0) first = 0;
+    long data_start = ftell(in);
+    long skip = first;
+    
+    char trailer[12];
+    int indexed = data_start >= 0 && fseek(in, -12, SEEK_END) == 0 && fread(trailer, 1, 12, in) == 12 &&
+                  memcmp(trailer + 8, "BSAI", 4) == 0;
+    long long stored = J;
+    if (indexed) {
+        uint64_t index_offset = 0, games = 0, blocks = 0, delta = 0;
+        long offset = 0;
+        for (int i = 0; i < 8; i++) index_offset |= (uint64_t)(unsigned char)trailer[i] << (8 * i);
+        
+        fseek(in, (long)index_offset, SEEK_SET);
+        get_varint(in, &games);
+        get_varint(in, &blocks);
+        stored = (long long)games;
+        uint64_t block = (uint64_t)first / ARCHIVE_BLOCK_GAMES;
+        for (uint64_t i = 0; i <= block && i < blocks; i++) {
+            get_varint(in, &delta);
+            offset += (long)delta;
+        }
+        if (block < blocks) {
+            fseek(in, offset, SEEK_SET);
+            skip = first % ARCHIVE_BLOCK_GAMES;
+        } else {
+            fseek(in, data_start, SEEK_SET);
+            skip = 0;
+            stored = 0;  // Nothing at or after first
+        }
+    } else if (data_start >= 0) {
+        fseek(in, data_start, SEEK_SET);  // Read through from the start
+    }
+    
+    long long wanted = stored - first;
+    if (count >= 0 && count < wanted) wanted = count;
+    if (wanted < 0) wanted = 0;
+    write_int(out, wanted);
+    putc_unlocked('\n', out);
+    
+    for (long i = 0; i < skip; i++) {
+        if (!unarchive_game(in, NULL)) break;
+    }
+    
+    long decoded = 0;
+    while (decoded < wanted) {
+        if (!unarchive_game(in, out)) break;
+        decoded++;
+    }
+    return decoded;
+}
+
+// ---------------------------------------------------------------------------
+// Board cache. Corpora replay the same fleet layouts over and over, so the
+// boards built from a placement list are kept. Layouts are chained by a
+// hash of (N, M, first placement record), and the placement lines of a game
+// are matched against a cached list with the same start while they are
+// read. When a whole list matches, the fleets are complete at the same line
+// as when it was placed, so nothing is placed at all and the match gets
+// clones of the layout. Only when no list matches are the lines read so far
+// placed for real, and the boards built then go into the cache. General
+// boards share the ship geometry and the tiles with the cached layout and
+// copy a tile on its first hit; bitboards are small enough to copy whole.
+// The cache is bounded in bytes and drops least recently used layouts; a
+// dropped layout lives on until its last clone is destroyed.
+// ---------------------------------------------------------------------------
+
+#define LAYOUT_MAX_PROBES 16  // Chain entries tried when a candidate diverges
+
+struct BoardLayout {
+    uint64_t key;               // Hash of N, M and the first record
+    int N, M;
+    PlacementRecord *records;   // Placement list the layout was built from
+    int record_count;
+    int ship_count;             // Per player
+    int placed[5];              // Ships of each type in both fleets
+    PlayerBoard *players[2];    // Never written once built
+    SmallBoard *small;
+    size_t bytes;
+    atomic_long refs;           // One for the cache, one per clone
+    BoardLayout *next;          // Hash chain, most recently used first
+    BoardLayout *newer, *older; // Recency list
+};
+
+typedef struct {
+    BoardLayout **buckets;
+    size_t bucket_mask;
+    BoardLayout *newest, *oldest;
+    long entries;
+    size_t bytes;
+    size_t max_bytes;
+    long long lookups, hits, misses, evictions;
+    long long uncached;         // Placement never completed, nothing to keep
+    pthread_mutex_t lock;
+} BoardCache;
+
+BoardCache* create_board_cache(size_t max_bytes) {
+    BoardCache *cache = (BoardCache*)calloc(1, sizeof(BoardCache));
+    cache->bucket_mask = 255;
+    cache->buckets = (BoardLayout**)calloc(cache->bucket_mask + 1, sizeof(BoardLayout*));
+    cache->max_bytes = max_bytes;
+    pthread_mutex_init(&cache->lock, NULL);
+    return cache;
+}
+
+static void free_layout(BoardLayout *layout) {
+    destroy_board(layout->players[0]);
+    destroy_board(layout->players[1]);
+    free(layout->small);
+    free(layout->records);
+    free(layout);
+}
+
+void release_layout(BoardLayout *layout) {
+    if (atomic_fetch_sub(&layout->refs, 1) == 1) free_layout(layout);
+}
+
+static uint64_t layout_key(int N, int M, PlacementRecord *first) {
+    uint64_t key = mix64((uint64_t)(uint32_t)N << 32 | (uint32_t)M);
+    key = mix64(key ^ ((uint64_t)(unsigned char)first->type << 8 | (unsigned char)first->orientation));
+    return mix64(key ^ ((uint64_t)(uint32_t)first->x << 32 | (uint32_t)first->y));
+}
+
+static inline int same_record(const PlacementRecord *a, const PlacementRecord *b) {
+    return a->type == b->type && a->orientation == b->orientation && a->x == b->x && a->y == b->y;
+}
+
+// Layout whose list starts with the records of game read so far
+static int layout_extends(BoardLayout *layout, uint64_t key, GameRecord *game) {
+    if (layout->key != key || layout->N != game->N || layout->M != game->M ||
+        layout->record_count < game->placement_count) {
+        return 0;
+    }
+    for (int i = 0; i < game->placement_count; i++) {
+        if (!same_record(&layout->records[i], &game->placements[i])) return 0;
+    }
+    return 1;
+}
+
+// Heap bytes held by one general board
+static size_t board_bytes(PlayerBoard *board) {
+    size_t tiles = (size_t)board->tile_rows * board->tile_cols;
+    size_t bytes = sizeof(PlayerBoard) + (tiles + 1) * sizeof(BoardTile*) +
+                   (size_t)(board->ship_count + 1) * (4 + 2 * sizeof(int)) +
+                   ((board->ship_count >> 6) + 1) * sizeof(uint64_t);
+    for (size_t i = 0; i < tiles; i++) {
+        if (board->tiles[i]) bytes += sizeof(BoardTile);
+    }
+    return bytes;
+}
+
+// Recency list helpers, called with the lock held
+static void unlink_recent(BoardCache *cache, BoardLayout *layout) {
+    if (layout->newer) layout->newer->older = layout->older;
+    else cache->newest = layout->older;
+    if (layout->older) layout->older->newer = layout->newer;
+    else cache->oldest = layout->newer;
+}
+
+static void push_recent(BoardCache *cache, BoardLayout *layout) {
+    layout->newer = NULL;
+    layout->older = cache->newest;
+    if (cache->newest) cache->newest->newer = layout;
+    else cache->oldest = layout;
+    cache->newest = layout;
+}
+
+static void evict_oldest(BoardCache *cache) {
+    BoardLayout *layout = cache->oldest;
+    BoardLayout **link = &cache->buckets[layout->key & cache->bucket_mask];
+    while (*link != layout) link = &(*link)->next;
+    *link = layout->next;
+    unlink_recent(cache, layout);
+    cache->entries--;
+    cache->bytes -= layout->bytes;
+    cache->evictions++;
+    release_layout(layout);
+}
+
+// Rehash oldest first, so every chain stays most recently used first
+static void grow_buckets(BoardCache *cache) {
+    size_t mask = cache->bucket_mask * 2 + 1;
+    BoardLayout **buckets = (BoardLayout**)calloc(mask + 1, sizeof(BoardLayout*));
+    for (BoardLayout *layout = cache->oldest; layout; layout = layout->newer) {
+        layout->next = buckets[layout->key & mask];
+        buckets[layout->key & mask] = layout;
+    }
+    free(cache->buckets);
+    cache->buckets = buckets;
+    cache->bucket_mask = mask;
+}
+
+// Cached layout, other than skip, whose list starts with the records read
+// so far, with a reference taken for the caller; NULL if there is none
+static BoardLayout* find_layout(BoardCache *cache, GameRecord *game, BoardLayout *skip) {
+    uint64_t key = layout_key(game->N, game->M, &game->placements[0]);
+    
+    BoardLayout *found = NULL;
+    pthread_mutex_lock(&cache->lock);
+    BoardLayout *layout = cache->buckets[key & cache->bucket_mask];
+    for (int probes = 0; layout && probes < LAYOUT_MAX_PROBES; layout = layout->next, probes++) {
+        if (layout != skip && layout_extends(layout, key, game)) {
+            found = layout;
+            atomic_fetch_add(&found->refs, 1);
+            break;
+        }
+    }
+    pthread_mutex_unlock(&cache->lock);
+    return found;
+}
+
+// Count a hit on layout and make it the most recently used, unless it was
+// dropped meanwhile
+static void touch_layout(BoardCache *cache, BoardLayout *layout) {
+    pthread_mutex_lock(&cache->lock);
+    cache->lookups++;
+    cache->hits++;
+    BoardLayout **link = &cache->buckets[layout->key & cache->bucket_mask];
+    while (*link && *link != layout) link = &(*link)->next;
+    if (*link) {
+        *link = layout->next;
+        layout->next = cache->buckets[layout->key & cache->bucket_mask];
+        cache->buckets[layout->key & cache->bucket_mask] = layout;
+        unlink_recent(cache, layout);
+        push_recent(cache, layout);
+    }
+    pthread_mutex_unlock(&cache->lock);
+}
+
+// Give the match its own boards over the layout, taking a reference
+static void clone_layout_boards(Match *match, BoardLayout *layout, int silent) {
+    atomic_fetch_add(&layout->refs, 1);
+    match->layout = layout;
+    if (layout->small) {
+        match->small = (SmallBoard*)malloc(2 * sizeof(SmallBoard));
+        memcpy(match->small, layout->small, 2 * sizeof(SmallBoard));
+    } else {
+        match->players[0] = clone_board(layout->players[0]);
+        match->players[1] = clone_board(layout->players[1]);
+    }
+    for (int p = 0; p < 2; p++) {
+        if (match->small) match->small[p].silent = silent;
+        else match->players[p]->silent = silent;
+    }
+}
+
+// Match with both fleets of the layout already placed, in the attack phase
+static Match* create_layout_match(BoardLayout *layout, int id, int flags) {
+    Match *match = (Match*)calloc(1, sizeof(Match));
+    match->id = id;
+    match->ship_count = layout->ship_count;
+    clone_layout_boards(match, layout, (flags & MATCH_SILENT) != 0);
+    match->placed[0] = match->placed[1] = layout->ship_count;
+    match->current_player = 1;
+    match->salvo_mode = (flags & MATCH_SALVO) != 0;
+    if (match->salvo_mode) {
+        match->salvo = (int (*)[2])malloc((layout->ship_count + 1) * sizeof(*match->salvo));
+    }
+    match->phase = PHASE_ATTACK;
+    return match;
+}
+
+// Move the boards of a match just placed from the game's records into a
+// new cached layout and give the match clones of them, unless the layout
+// alone is over the cache bound. The match must not have been attacked.
+static void adopt_layout(BoardCache *cache, Match *match, GameRecord *game) {
+    size_t bytes = sizeof(BoardLayout) + (game->placement_count + 1) * sizeof(PlacementRecord);
+    if (match->small) {
+        bytes += 2 * sizeof(SmallBoard);
+    } else {
+        bytes += board_bytes(match->players[0]) + board_bytes(match->players[1]);
+    }
+    if (bytes > cache->max_bytes) return;
+    
+    BoardLayout *layout = (BoardLayout*)calloc(1, sizeof(BoardLayout));
+    layout->key = layout_key(game->N, game->M, &game->placements[0]);
+    layout->N = game->N;
+    layout->M = game->M;
+    layout->record_count = game->placement_count;
+    layout->records = (PlacementRecord*)malloc((game->placement_count + 1) * sizeof(PlacementRecord));
+    memcpy(layout->records, game->placements, game->placement_count * sizeof(PlacementRecord));
+    layout->ship_count = match->ship_count;
+    memcpy(layout->placed, game->placed, sizeof(layout->placed));
+    layout->bytes = bytes;
+    layout->small = match->small;
+    layout->players[0] = match->players[0];
+    layout->players[1] = match->players[1];
+    atomic_init(&layout->refs, 1);
+    clone_layout_boards(match, layout, 1);
+    
+    pthread_mutex_lock(&cache->lock);
+    BoardLayout **bucket = &cache->buckets[layout->key & cache->bucket_mask];
+    layout->next = *bucket;
+    *bucket = layout;
+    push_recent(cache, layout);
+    cache->entries++;
+    cache->bytes += layout->bytes;
+    while (cache->bytes > cache->max_bytes) evict_oldest(cache);
+    if ((size_t)cache->entries > cache->bucket_mask) grow_buckets(cache);
+    pthread_mutex_unlock(&cache->lock);
+}
+
+// Place record i of the game on the match, counting accepted ships by type
+static void place_record(Match *match, GameRecord *game, int i) {
+    PlacementRecord *p = &game->placements[i];
+    if (match_place(match, match_next_placer(match), p->type, p->orientation, p->x, p->y)) {
+        game->placed[type_index(p->type)]++;
+    }
+}
+
+// read_game() that also plays the attacks once, silently, and records in
+// game->outcomes what each of them hit, as read off the events ring
+// receives (it must be empty and is left empty). With a cache, placement
+// lines are only placed when no cached list starts the same way, and the
+// attacks are played on clones of the cached layout.
+static int read_game_outcomes(FILE *in, int id, GameRecord *game, BoardCache *cache, EventRing *ring) {
+    if (!read_int(in, &game->N) || !read_int(in, &game->M) || game->N < 1 || game->M < 1) {
+        return 0;
+    }
+    
+    game->placement_count = 0;
+    game->attack_count = 0;
+    memset(game->placed, 0, sizeof(game->placed));
+    BoardLayout *candidate = NULL;  // Cached list matching every line so far
+    Match *match = NULL;
+    if (!cache || calculate_total_ships(game->N, game->M) == 0) {
+        match = create_match(id, game->N, game->M, MATCH_SILENT);
+    }
+    
+    PlacementRecord record;
+    while ((!match || match->phase == PHASE_PLACEMENT) &&
+           read_char(in, &record.type) && read_char(in, &record.orientation) &&
+           read_int(in, &record.x) && read_int(in, &record.y)) {
+        if (game->placement_count == game->placement_capacity) {
+            game->placement_capacity = game->placement_capacity ? game->placement_capacity * 2 : 256;
+            game->placements = (PlacementRecord*)realloc(game->placements,
+                                                         game->placement_capacity * sizeof(PlacementRecord));
+        }
+        int count = ++game->placement_count;
+        game->placements[count - 1] = record;
+        
+        if (match) {
+            place_record(match, game, count - 1);
+            continue;
+        }
+        if (count == 1) {
+            candidate = find_layout(cache, game, NULL);
+        } else if (candidate && !same_record(&candidate->records[count - 1], &record)) {
+            BoardLayout *other = find_layout(cache, game, candidate);
+            release_layout(candidate);
+            candidate = other;
+        }
+        if (candidate && candidate->record_count == count) break;  // Fleets complete
+        if (candidate) continue;
+        
+        // No cached list goes on like this one: place the lines read so far
+        match = create_match(id, game->N, game->M, MATCH_SILENT);
+        for (int i = 0; i < count; i++) place_record(match, game, i);
+    }
+    
+    if (candidate && candidate->record_count == game->placement_count) {
+        match = create_layout_match(candidate, id, MATCH_SILENT);
+        memcpy(game->placed, candidate->placed, sizeof(game->placed));
+        touch_layout(cache, candidate);
+        release_layout(candidate);
+    } else {
+        if (candidate) release_layout(candidate);  // Input ended inside the list
+        if (!match) {
+            match = create_match(id, game->N, game->M, MATCH_SILENT);
+            for (int i = 0; i < game->placement_count; i++) place_record(match, game, i);
+        }
+        if (cache && game->placement_count > 0) {
+            pthread_mutex_lock(&cache->lock);
+            cache->lookups++;
+            cache->misses++;
+            if (match->phase != PHASE_ATTACK) cache->uncached++;
+            pthread_mutex_unlock(&cache->lock);
+            if (match->phase == PHASE_ATTACK && game->placement_count > 0) adopt_layout(cache, match, game);
+        }
+    }
+    
+    match_set_events(match, ring);
+    int x, y;
+    while (match->phase == PHASE_ATTACK && read_int(in, &x) && read_int(in, &y)) {
+        if (game->attack_count == game->attack_capacity) {
+            game->attack_capacity = game->attack_capacity ? game->attack_capacity * 2 : 1024;
+            game->attacks = (int (*)[2])realloc(game->attacks, game->attack_capacity * sizeof(*game->attacks));
+        }
+        if (game->attack_count == game->outcome_capacity) {
+            game->outcome_capacity = game->attack_capacity;
+            game->outcomes = (unsigned char*)realloc(game->outcomes, game->outcome_capacity);
+        }
+        game->attacks[game->attack_count][0] = x;
+        game->attacks[game->attack_count][1] = y;
+        match_attack(match, match->current_player, x, y);
+        
+        unsigned char outcome = 0;
+        GameEvent event;
+        while (consume_event(ring, &event)) {
+            if (event.kind == EVENT_HIT) outcome = OUTCOME(type_index(event.ship_type), event.result);
+        }
+        game->outcomes[game->attack_count++] = outcome;
+    }
+    
+    game->finished = match->phase == PHASE_FINISHED;
+    destroy_match(match);
+    return 1;
+}
+
+void destroy_board_cache(BoardCache *cache) {
+    if (!cache) return;
+    while (cache->oldest) evict_oldest(cache);
+    pthread_mutex_destroy(&cache->lock);
+    free(cache->buckets);
+    free(cache);
+}
+
+void print_cache_stats(BoardCache *cache, FILE *out) {
+    fprintf(out, "Cache de table: %lld căutări, %lld găsite (%.1f%%), %lld ratate, %lld necompletate, "
+                 "%lld eliminate, %ld intrări, %.1f / %.1f MB\n",
+            cache->lookups, cache->hits, cache->lookups ? 100.0 * cache->hits / cache->lookups : 0.0,
+            cache->misses, cache->uncached, cache->evictions, cache->entries,
+            cache->bytes / 1048576.0, cache->max_bytes / 1048576.0);
+}
+
+// ---------------------------------------------------------------------------
+// Cross-game statistics. The reader plays every game once, through its
+// event ring, and records what each attack hit (read_game_outcomes()).
+// Batches of recorded games are then counted on several threads, each into
+// its own cache line aligned histograms, while the reader goes on with the
+// next batch; the histograms are summed in parallel at the end. Output is
+// CSV.
+// ---------------------------------------------------------------------------
+
+#define STATS_BATCH_GAMES 4096
+#define STATS_MAX_SHOTS 4096   // Last shots-to-win bucket collects the rest
+#define STATS_MAX_SIDE 4096    // Cells beyond this are not tracked
+
+typedef struct {
+    _Alignas(64) long long sunk[5];
+    long long head_kills[5];
+    long long sink_shots[5];     // Sum of the shot number that sank each ship
+    long long afloat[5];         // Ships never sunk
+    long long games;
+    long long unfinished;
+    int N, M;                    // Size of the cell grids
+    long long *cell_shots;       // N * M, shots at each cell
+    long long *cell_hits;        // N * M, ship hits at each cell
+    long long *shots_to_win;     // STATS_MAX_SHOTS + 1 buckets
+} GameStats;
+
+static void* aligned_calloc(size_t bytes) {
+    void *memory = NULL;
+    bytes = (bytes + 63) & ~(size_t)63;  // Whole cache lines, no sharing
+    if (posix_memalign(&memory, 64, bytes) != 0) return NULL;
+    memset(memory, 0, bytes);
+    return memory;
+}
+
+// Grow the cell grids to at least N x M, keeping the counts
+static void stats_resize(GameStats *stats, int N, int M) {
+    if (N <= stats->N && M <= stats->M) return;
+    int new_N = N > stats->N ? N : stats->N;
+    int new_M = M > stats->M ? M : stats->M;
+    
+    long long *shots = (long long*)aligned_calloc((size_t)new_N * new_M * sizeof(long long));
+    long long *hits = (long long*)aligned_calloc((size_t)new_N * new_M * sizeof(long long));
+    for (int i = 0; i < stats->N; i++) {
+        memcpy(shots + (size_t)i * new_M, stats->cell_shots + (size_t)i * stats->M, stats->M * sizeof(long long));
+        memcpy(hits + (size_t)i * new_M, stats->cell_hits + (size_t)i * stats->M, stats->M * sizeof(long long));
+    }
+    free(stats->cell_shots);
+    free(stats->cell_hits);
+    stats->cell_shots = shots;
+    stats->cell_hits = hits;
+    stats->N = new_N;
+    stats->M = new_M;
+}
+
+// Count one recorded game
+static void count_game(GameStats *stats, GameRecord *game) {
+    long long sunk[5] = {0, 0, 0, 0, 0};
+    
+    for (long i = 0; i < game->attack_count; i++) {
+        int x = game->attacks[i][0], y = game->attacks[i][1];
+        int tracked = x >= 1 && y >= 1 && x <= stats->N && y <= stats->M;
+        if (tracked) stats->cell_shots[(size_t)(x - 1) * stats->M + (y - 1)]++;
+        
+        unsigned char outcome = game->outcomes[i];
+        if (!outcome) continue;
+        int t = OUTCOME_TYPE(outcome);
+        int result = OUTCOME_RESULT(outcome);
+        if (tracked) stats->cell_hits[(size_t)(x - 1) * stats->M + (y - 1)]++;
+        if (result >= 2) {
+            sunk[t]++;
+            stats->sink_shots[t] += i + 1;
+        }
+        if (result == HIT_HEAD) stats->head_kills[t]++;
+    }
+    
+    stats->games++;
+    if (game->finished) {
+        long shots = game->attack_count < STATS_MAX_SHOTS ? game->attack_count : STATS_MAX_SHOTS;
+        stats->shots_to_win[shots]++;
+    } else {
+        stats->unfinished++;
+    }
+    for (int t = 0; t < 5; t++) {
+        stats->sunk[t] += sunk[t];
+        stats->afloat[t] += game->placed[t] - sunk[t];
+    }
+}
+
+typedef struct {
+    GameStats *stats;
+    GameRecord *games;
+    int first, count;
+    // Reduction pass: sum cells [cell_first, cell_last) of every thread
+    GameStats *all;
+    int thread_count;
+    size_t cell_first, cell_last;
+} StatsTask;
+
+static void* stats_worker(void *arg) {
+    StatsTask *task = (StatsTask*)arg;
+    for (int i = task->first; i < task->first + task->count; i++) {
+        count_game(task->stats, &task->games[i]);
+    }
+    return NULL;
+}
+
+static void* stats_reduce_worker(void *arg) {
+    StatsTask *task = (StatsTask*)arg;
+    GameStats *total = &task->all[0];
+    for (int t = 1; t < task->thread_count; t++) {
+        GameStats *part = &task->all[t];
+        for (size_t c = task->cell_first; c < task->cell_last; c++) {
+            total->cell_shots[c] += part->cell_shots[c];
+            total->cell_hits[c] += part->cell_hits[c];
+        }
+    }
+    return NULL;
+}
+
+// Replay every text game from in and print the aggregated statistics. Built
+// boards are cached up to cache_mb megabytes, 0 turns the cache off.
+int run_stats(FILE *in, FILE *out, int thread_count, long cache_mb) {
+    if (thread_count < 1) {
+        thread_count = (int)sysconf(_SC_NPROCESSORS_ONLN);
+        if (thread_count < 1) thread_count = 1;
+    }
+    
+    int J;
+    if (!read_int(in, &J)) return 1;
+    
+    GameStats *stats = (GameStats*)aligned_calloc(thread_count * sizeof(GameStats));
+    for (int t = 0; t < thread_count; t++) {
+        stats[t].shots_to_win = (long long*)aligned_calloc((STATS_MAX_SHOTS + 1) * sizeof(long long));
+        stats_resize(&stats[t], 1, 1);
+    }
+    
+    GameRecord *batches[2];
+    batches[0] = (GameRecord*)calloc(STATS_BATCH_GAMES, sizeof(GameRecord));
+    batches[1] = (GameRecord*)calloc(STATS_BATCH_GAMES, sizeof(GameRecord));
+    pthread_t *threads = (pthread_t*)malloc(thread_count * sizeof(pthread_t));
+    StatsTask *tasks = (StatsTask*)calloc(thread_count, sizeof(StatsTask));
+    BoardCache *cache = cache_mb > 0 ? create_board_cache((size_t)cache_mb << 20) : NULL;
+    EventRing *ring = create_event_ring(16);
+    int game = 0;
+    int current = 0;
+    int counting = 0;
+    
+    while (1) {
+        // Play a batch while the threads count the previous one
+        GameRecord *batch = batches[current];
+        int count = 0;
+        int max_N = 1, max_M = 1;
+        while (count < STATS_BATCH_GAMES && game + count < J &&
+               read_game_outcomes(in, game + count, &batch[count], cache, ring)) {
+            if (batch[count].N > max_N) max_N = batch[count].N;
+            if (batch[count].M > max_M) max_M = batch[count].M;
+            count++;
+        }
+        if (counting) {
+            for (int t = 0; t < thread_count; t++) {
+                pthread_join(threads[t], NULL);
+            }
+            counting = 0;
+        }
+        if (count == 0) break;
+        
+        if (max_N > STATS_MAX_SIDE) max_N = STATS_MAX_SIDE;
+        if (max_M > STATS_MAX_SIDE) max_M = STATS_MAX_SIDE;
+        for (int t = 0; t < thread_count; t++) {
+            stats_resize(&stats[t], max_N, max_M);
+            tasks[t].stats = &stats[t];
+            tasks[t].games = batch;
+            tasks[t].first = (int)((long long)count * t / thread_count);
+            tasks[t].count = (int)((long long)count * (t + 1) / thread_count) - tasks[t].first;
+            pthread_create(&threads[t], NULL, stats_worker, &tasks[t]);
+        }
+        counting = 1;
+        game += count;
+        current = 1 - current;
+    }
+    
+    // Parallel reduction of the cell grids into stats[0]
+    size_t cells = (size_t)stats[0].N * stats[0].M;
+    for (int t = 0; t < thread_count; t++) {
+        stats_resize(&stats[t], stats[0].N, stats[0].M);
+    }
+    for (int t = 0; t < thread_count; t++) {
+        tasks[t].all = stats;
+        tasks[t].thread_count = thread_count;
+        tasks[t].cell_first = cells * t / thread_count;
+        tasks[t].cell_last = cells * (t + 1) / thread_count;
+        pthread_create(&threads[t], NULL, stats_reduce_worker, &tasks[t]);
+    }
+    for (int t = 0; t < thread_count; t++) {
+        pthread_join(threads[t], NULL);
+    }
+    
+    GameStats *total = &stats[0];
+    for (int t = 1; t < thread_count; t++) {
+        for (int k = 0; k < 5; k++) {
+            total->sunk[k] += stats[t].sunk[k];
+            total->head_kills[k] += stats[t].head_kills[k];
+            total->sink_shots[k] += stats[t].sink_shots[k];
+            total->afloat[k] += stats[t].afloat[k];
+        }
+        for (int k = 0; k <= STATS_MAX_SHOTS; k++) {
+            total->shots_to_win[k] += stats[t].shots_to_win[k];
+        }
+        total->games += stats[t].games;
+        total->unfinished += stats[t].unfinished;
+    }
+    
+    static const char types[] = "SYBLA";
+    fprintf(out, "games,unfinished\n%lld,%lld\n", total->games, total->unfinished);
+    fprintf(out, "\ntype,sunk,head_kills,mean_shots_to_sink,afloat\n");
+    for (int k = 0; k < 5; k++) {
+        fprintf(out, "%c,%lld,%lld,%.2f,%lld\n", types[k], total->sunk[k], total->head_kills[k],
+                total->sunk[k] ? (double)total->sink_shots[k] / total->sunk[k] : 0.0, total->afloat[k]);
+    }
+    fprintf(out, "\nshots_to_win,games\n");
+    for (int k = 0; k <= STATS_MAX_SHOTS; k++) {
+        if (total->shots_to_win[k]) fprintf(out, "%d,%lld\n", k, total->shots_to_win[k]);
+    }
+    fprintf(out, "\nx,y,shots,hits\n");
+    for (int i = 0; i < total->N; i++) {
+        for (int j = 0; j < total->M; j++) {
+            size_t c = (size_t)i * total->M + j;
+            if (total->cell_shots[c]) {
+                fprintf(out, "%d,%d,%lld,%lld\n", i + 1, j + 1, total->cell_shots[c], total->cell_hits[c]);
+            }
+        }
+    }
+    
+    if (cache) {
+        print_cache_stats(cache, stderr);
+        destroy_board_cache(cache);
+    }
+    for (int i = 0; i < STATS_BATCH_GAMES; i++) {
+        free_game_record(&batches[0][i]);
+        free_game_record(&batches[1][i]);
+    }
+    destroy_event_ring(ring);
+    for (int t = 0; t < thread_count; t++) {
+        free(stats[t].cell_shots);
+        free(stats[t].cell_hits);
+        free(stats[t].shots_to_win);
+    }
+    free(stats);
+    free(batches[0]);
+    free(batches[1]);
+    free(threads);
+    free(tasks);
+    return 0;
+}
+
+// ---------------------------------------------------------------------------
+// Fleet feasibility. Decides whether a quota (the standard one or custom
+// counts per type) fits on an N x M board and returns a packing when it
+// does. A first-fit row packing settles nearly every case at once; the rest
+// goes to a backtracking search over row bitboards that remembers failed
+// states, within a time budget.
+// ---------------------------------------------------------------------------
+
+#define FEASIBLE_NO      0
+#define FEASIBLE_YES     1
+#define FEASIBLE_UNKNOWN 2  // Time budget ran out first
+#define FEASIBLE_MEMO_BITS 18
+#define FEASIBLE_MEMO_PROBES 8
+
+// Search state that is known not to lead to a packing
+typedef struct {
+    uint64_t frontier[5];  // Rows r..r+4 as seen from the current cell on
+    int cell;              // Current cell + 1, 0 for an empty slot
+    int counts[5];
+} FeasibleMemo;
+
+typedef struct {
+    int rows, cols;        // Search grid: the board, transposed if narrower that way
+    int transposed;
+    int counts[5];         // Ships left per type (S Y B L A)
+    long long slack;       // Cells that may still stay empty
+    uint64_t *occupied;    // One word per grid row
+    ShipPlacement *fleet;
+    int placed;
+    FeasibleMemo *memo;
+    long long nodes;
+    struct timespec deadline;
+    int timed_out;
+} FeasibleSearch;
+
+static const char feasible_types[] = "SYBLA";
+
+// Record a ship that covers grid cells from (r, c) to the right or down
+static void feasible_put(ShipPlacement *ship, int t, int across, int transposed, int r, int c) {
+    int length = get_ship_length(feasible_types[t]);
+    ship->type = feasible_types[t];
+    if (transposed) {
+        // Grid rows are board columns: across is a vertical ship on the board
+        across = !across;
+        int swap = r;
+        r = c;
+        c = swap;
+    }
+    if (across || length == 1) {
+        ship->orientation = 'H';
+        ship->x = r + 1;
+        ship->y = c + 1;
+    } else {
+        // V ships grow upwards from the start
+        ship->orientation = 'V';
+        ship->x = r + length;
+        ship->y = c + 1;
+    }
+}
+
+// First fit by decreasing length into rows of the grid, all ships across
+static int feasible_greedy(int N, int M, const int counts[5], int transposed, ShipPlacement *fleet) {
+    int rows = transposed ? M : N;
+    int cols = transposed ? N : M;
+    int *free_cols = (int*)malloc(rows * sizeof(int));
+    int placed = 0;
+    
+    for (int r = 0; r < rows; r++) free_cols[r] = cols;
+    for (int t = 0; t < 5; t++) {
+        int length = get_ship_length(feasible_types[t]);
+        int r = 0;
+        for (int k = 0; k < counts[t]; k++) {
+            while (r < rows && free_cols[r] < length) r++;
+            if (r == rows) {
+                free(free_cols);
+                return 0;
+            }
+            feasible_put(&fleet[placed++], t, 1, transposed, r, cols - free_cols[r]);
+            free_cols[r] -= length;
+        }
+    }
+    free(free_cols);
+    return 1;
+}
+
+static uint64_t memo_key(FeasibleSearch *search, int cell, uint64_t *frontier) {
+    int r = cell / search->cols;
+    int c = cell % search->cols;
+    uint64_t h = mix64((uint64_t)cell);
+    for (int i = 0; i < 5; i++) {
+        uint64_t row = (r + i < search->rows) ? search->occupied[r + i] : 0;
+        if (i == 0) row &= ~(uint64_t)0 << c;
+        frontier[i] = row;
+        h = mix64(h ^ row ^ ((uint64_t)search->counts[i] << 40));
+    }
+    return h;
+}
+
+static int memo_lookup(FeasibleSearch *search, int cell) {
+    uint64_t frontier[5];
+    uint64_t h = memo_key(search, cell, frontier);
+    uint64_t mask = ((uint64_t)1 << FEASIBLE_MEMO_BITS) - 1;
+    for (int p = 0; p < FEASIBLE_MEMO_PROBES; p++) {
+        FeasibleMemo *slot = &search->memo[(h + p) & mask];
+        if (slot->cell == 0) return 0;
+        if (slot->cell == cell + 1 && memcmp(slot->frontier, frontier, sizeof(frontier)) == 0 &&
+            memcmp(slot->counts, search->counts, sizeof(slot->counts)) == 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static void memo_store(FeasibleSearch *search, int cell) {
+    uint64_t frontier[5];
+    uint64_t h = memo_key(search, cell, frontier);
+    uint64_t mask = ((uint64_t)1 << FEASIBLE_MEMO_BITS) - 1;
+    for (int p = 0; p < FEASIBLE_MEMO_PROBES; p++) {
+        FeasibleMemo *slot = &search->memo[(h + p) & mask];
+        if (slot->cell == 0) {
+            slot->cell = cell + 1;
+            memcpy(slot->frontier, frontier, sizeof(frontier));
+            memcpy(slot->counts, search->counts, sizeof(slot->counts));
+            return;
+        }
+    }
+}
+
+// Cover the grid in cell order: every free cell either starts a ship going
+// right or down, or stays empty while there is slack. Filling in order means
+// interchangeable ships are never tried in permuted positions.
+static int feasible_search(FeasibleSearch *search, int cell) {
+    int cols = search->cols;
+    int total = search->rows * cols;
+    while (cell < total && ((search->occupied[cell / cols] >> (cell % cols)) & 1)) cell++;
+    
+    int left = 0;
+    for (int t = 0; t < 5; t++) left += search->counts[t];
+    if (left == 0) return 1;
+    if (cell == total || search->timed_out) return 0;
+    
+    if ((++search->nodes & 1023) == 0) {
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        if (now.tv_sec > search->deadline.tv_sec ||
+            (now.tv_sec == search->deadline.tv_sec && now.tv_nsec >= search->deadline.tv_nsec)) {
+            search->timed_out = 1;
+            return 0;
+        }
+    }
+    if (memo_lookup(search, cell)) return 0;
+    
+    int r = cell / cols;
+    int c = cell % cols;
+    uint64_t *occupied = search->occupied;
+    
+    for (int t = 0; t < 5; t++) {
+        if (search->counts[t] == 0) continue;
+        int length = get_ship_length(feasible_types[t]);
+        
+        // Across the row
+        uint64_t span = (((uint64_t)1 << length) - 1) << c;
+        if (c + length <= cols && !(occupied[r] & span)) {
+            occupied[r] |= span;
+            search->counts[t]--;
+            feasible_put(&search->fleet[search->placed++], t, 1, search->transposed, r, c);
+            if (feasible_search(search, cell + length)) return 1;
+            search->placed--;
+            search->counts[t]++;
+            occupied[r] &= ~span;
+        }
+        
+        // Down the column
+        uint64_t bit = (uint64_t)1 << c;
+        if (length > 1 && r + length <= search->rows) {
+            int fits = 1;
+            for (int i = 1; i < length && fits; i++) fits = !(occupied[r + i] & bit);
+            if (fits) {
+                for (int i = 0; i < length; i++) occupied[r + i] |= bit;
+                search->counts[t]--;
+                feasible_put(&search->fleet[search->placed++], t, 0, search->transposed, r, c);
+                if (feasible_search(search, cell + 1)) return 1;
+                search->placed--;
+                search->counts[t]++;
+                for (int i = 0; i < length; i++) occupied[r + i] &= ~bit;
+            }
+        }
+    }
+    
+    // Leave the cell empty
+    if (search->slack > 0) {
+        search->slack--;
+        int found = feasible_search(search, cell + 1);
+        search->slack++;
+        if (found) return 1;
+    }
+    
+    if (!search->timed_out) memo_store(search, cell);
+    return 0;
+}
+
+static int compare_placement_types(const void *a, const void *b) {
+    return type_index(((const ShipPlacement*)a)->type) - type_index(((const ShipPlacement*)b)->type);
+}
+
+// Decide whether counts[] ships (S Y B L A order) fit on an N x M board.
+// On FEASIBLE_YES fleet holds a packing, in the order main() reads it.
+int solve_fleet(int N, int M, const int counts[5], long budget_ms, ShipPlacement *fleet) {
+    long long area = (long long)N * M;
+    long long needed = 0;
+    for (int t = 0; t < 5; t++) {
+        int length = get_ship_length(feasible_types[t]);
+        if (counts[t] > 0 && length > N && length > M) return FEASIBLE_NO;
+        needed += (long long)counts[t] * length;
+    }
+    if (needed > area) return FEASIBLE_NO;
+    
+    if (feasible_greedy(N, M, counts, N < M, fleet) || feasible_greedy(N, M, counts, N >= M, fleet)) {
+        return FEASIBLE_YES;
+    }
+    
+    // Search on the narrow orientation, one word per row
+    FeasibleSearch search;
+    memset(&search, 0, sizeof(search));
+    search.transposed = M > N;
+    search.rows = search.transposed ? M : N;
+    search.cols = search.transposed ? N : M;
+    if (search.cols > 64) return FEASIBLE_UNKNOWN;
+    
+    memcpy(search.counts, counts, sizeof(search.counts));
+    search.slack = area - needed;
+    search.occupied = (uint64_t*)calloc(search.rows, sizeof(uint64_t));
+    search.fleet = fleet;
+    search.memo = (FeasibleMemo*)calloc((size_t)1 << FEASIBLE_MEMO_BITS, sizeof(FeasibleMemo));
+    clock_gettime(CLOCK_MONOTONIC, &search.deadline);
+    search.deadline.tv_sec += budget_ms / 1000;
+    search.deadline.tv_nsec += (budget_ms % 1000) * 1000000L;
+    if (search.deadline.tv_nsec >= 1000000000L) {
+        search.deadline.tv_sec++;
+        search.deadline.tv_nsec -= 1000000000L;
+    }
+    
+    int result = feasible_search(&search, 0) ? FEASIBLE_YES
+               : search.timed_out ? FEASIBLE_UNKNOWN : FEASIBLE_NO;
+    if (result == FEASIBLE_YES) {
+        qsort(fleet, search.placed, sizeof(ShipPlacement), compare_placement_types);
+    }
+    
+    free(search.occupied);
+    free(search.memo);
+    return result;
+}
+
+// Place a packing on a fresh board; returns 1 if every ship is accepted
+static int check_packing(int N, int M, ShipPlacement *fleet, int count) {
+    PlayerBoard *board = create_board(N, M, count);
+    int ok = 1;
+    for (int i = 0; i < count && ok; i++) {
+        ok = place_ship(board, fleet[i].type, fleet[i].orientation, fleet[i].x, fleet[i].y, i);
+    }
+    destroy_board(board);
+    return ok;
+}
+
+static void quota_counts(int N, int M, int *counts) {
+    for (int t = 0; t < 5; t++) {
+        counts[t] = calculate_ships_per_type(N, M, feasible_types[t]);
+    }
+}
+
+// Answer one board: the standard quota unless counts are given.
+// Prints the packing as placement lines when it exists.
+int run_feasible(int argc, char *argv[]) {
+    if (argc < 4) {
+        printf("Utilizare: %s --feasible N M [buget_ms [S Y B L A]]\n", argv[0]);
+        return 1;
+    }
+    int N = atoi(argv[2]);
+    int M = atoi(argv[3]);
+    long budget_ms = argc > 4 ? atol(argv[4]) : 1000;
+    int counts[5];
+    quota_counts(N, M, counts);
+    for (int t = 0; t < 5 && argc > 5 + t; t++) counts[t] = atoi(argv[5 + t]);
+    if (N < 1 || M < 1) return 1;
+    
+    int total = 0;
+    for (int t = 0; t < 5; t++) total += counts[t];
+    ShipPlacement *fleet = (ShipPlacement*)malloc((total + 1) * sizeof(ShipPlacement));
+    int result = solve_fleet(N, M, counts, budget_ms, fleet);
+    
+    if (result == FEASIBLE_YES) {
+        printf("Flota încape.\n");
+        for (int i = 0; i < total; i++) {
+            printf("%c %c %d %d\n", fleet[i].type, fleet[i].orientation, fleet[i].x, fleet[i].y);
+        }
+    } else if (result == FEASIBLE_NO) {
+        printf("Flota nu încape.\n");
+    } else {
+        printf("Nedeterminat: bugetul de timp s-a epuizat.\n");
+    }
+    free(fleet);
+    return result == FEASIBLE_UNKNOWN ? 2 : 0;
+}
+
+// Time the solver across board shapes, standard and tight custom quotas
+int run_feasible_bench(long budget_ms) {
+    static const struct {
+        int N, M;
+        int custom;
+        int counts[5];
+    } cases[] = {
+        {4, 5, 0, {0}}, {8, 8, 0, {0}}, {10, 10, 0, {0}}, {1, 100, 0, {0}},
+        {2, 350, 0, {0}}, {3, 1000, 0, {0}}, {100, 100, 0, {0}}, {1000, 1000, 0, {0}},
+        {4000, 3000, 0, {0}},
+        {8, 8, 1, {0, 16, 0, 0, 0}}, {5, 5, 1, {0, 0, 0, 12, 1}}, {7, 7, 1, {0, 0, 16, 0, 1}},
+        {9, 9, 1, {0, 20, 0, 0, 1}}, {6, 6, 1, {0, 9, 0, 0, 0}}, {10, 10, 1, {0, 25, 0, 0, 0}},
+        {11, 11, 1, {24, 0, 0, 0, 1}}, {12, 12, 1, {0, 0, 48, 0, 0}}, {3, 40, 1, {24, 0, 0, 0, 0}},
+    };
+    static const char *results[] = {"nu", "da", "nedeterminat"};
+    
+    printf("%-11s %-8s %-30s %-13s %10s %s\n", "tabla", "cote", "S Y B L A", "rezultat", "ms", "verificat");
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        int N = cases[i].N, M = cases[i].M;
+        int counts[5];
+        if (cases[i].custom) memcpy(counts, cases[i].counts, sizeof(counts));
+        else quota_counts(N, M, counts);
+        
+        int total = 0;
+        for (int t = 0; t < 5; t++) total += counts[t];
+        ShipPlacement *fleet = (ShipPlacement*)malloc((total + 1) * sizeof(ShipPlacement));
+        
+        struct timespec start, end;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        int result = solve_fleet(N, M, counts, budget_ms, fleet);
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        double ms = (end.tv_sec - start.tv_sec) * 1e3 + (end.tv_nsec - start.tv_nsec) / 1e6;
+        
+        char shape[32], quota[48];
+        snprintf(shape, sizeof(shape), "%dx%d", N, M);
+        snprintf(quota, sizeof(quota), "%d %d %d %d %d", counts[0], counts[1], counts[2], counts[3], counts[4]);
+        printf("%-11s %-8s %-30s %-13s %10.3f %s\n", shape, cases[i].custom ? "custom" : "standard",
+               quota, results[result], ms,
+               result == FEASIBLE_YES ? (check_packing(N, M, fleet, total) ? "da" : "NU") : "-");
+        free(fleet);
+    }
+    return 0;
+}
+
+// ---------------------------------------------------------------------------
+// Spectator feed. The live boards are mirrored into a POSIX shared memory
+// segment that any number of local readers can map (see spectator.c). The
+// game thread is the only writer and publishes under a sequence lock: the
+// counter is odd while a change is being written, and readers retry their
+// copy when it moved. Publishing is a few plain stores, no locks or system
+// calls, except for growing the segment when a bigger board comes along.
+// ---------------------------------------------------------------------------
+
+#define FEED_MAGIC 0x44454546u  // "FEED"
+#define FEED_LENGTH 0x07        // Cell byte: ship length, 0 for water
+#define FEED_HIT    0x08        // Cell byte: cell was shot
+
+// Segment header, followed by two boards of capacity cells each (row major,
+// board of player 1 first). Keep in sync with spectator.c.
+typedef struct {
+    uint32_t magic;
+    uint32_t capacity;         // Cells per board the segment has room for
+    _Atomic uint64_t seq;      // Odd while the game thread is writing
+    int32_t game;              // Game number, from 1
+    int32_t N, M;
+    int32_t phase;             // PHASE_* of the match
+    int32_t current_player;
+    int32_t winner;
+    int32_t ships_remaining[2];
+    int32_t closed;            // Set when the engine is done
+    int64_t shots;
+} FeedHeader;
+
+typedef struct {
+    int fd;
+    char name[64];
+    FeedHeader *header;
+    unsigned char *cells;
+    size_t size;               // Mapped bytes
+} Feed;
+
+static size_t feed_size(uint32_t capacity) {
+    return sizeof(FeedHeader) + 2 * (size_t)capacity;
+}
+
+// Map the segment with room for capacity cells per board
+static int feed_map(Feed *feed, uint32_t capacity) {
+    size_t size = feed_size(capacity);
+    if (ftruncate(feed->fd, (off_t)size) != 0) return 0;
+    
+    void *memory = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, feed->fd, 0);
+    if (memory == MAP_FAILED) return 0;
+    if (feed->header) munmap(feed->header, feed->size);
+    
+    feed->header = (FeedHeader*)memory;
+    feed->cells = (unsigned char*)memory + sizeof(FeedHeader);
+    feed->size = size;
+    return 1;
+}
+
+Feed* open_feed(const char *name) {
+    Feed *feed = (Feed*)calloc(1, sizeof(Feed));
+    snprintf(feed->name, sizeof(feed->name), "/%s", name[0] == '/' ? name + 1 : name);
+    feed->fd = shm_open(feed->name, O_CREAT | O_RDWR | O_TRUNC, 0644);
+    if (feed->fd < 0 || !feed_map(feed, 256)) {
+        if (feed->fd >= 0) close(feed->fd);
+        free(feed);
+        return NULL;
+    }
+    
+    memset(feed->header, 0, sizeof(FeedHeader));
+    feed->header->capacity = 256;
+    atomic_store(&feed->header->seq, 0);
+    feed->header->magic = FEED_MAGIC;
+    return feed;
+}
+
+static inline void feed_begin(Feed *feed) {
+    uint64_t seq = atomic_load_explicit(&feed->header->seq, memory_order_relaxed);
+    atomic_store_explicit(&feed->header->seq, seq + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+}
+
+static inline void feed_end(Feed *feed) {
+    uint64_t seq = atomic_load_explicit(&feed->header->seq, memory_order_relaxed);
+    atomic_store_explicit(&feed->header->seq, seq + 1, memory_order_release);
+}
+
+// Readers see the segment removed from the namespace but keep their mapping
+void close_feed(Feed *feed) {
+    if (!feed) return;
+    feed_begin(feed);
+    feed->header->closed = 1;
+    feed_end(feed);
+    munmap(feed->header, feed->size);
+    close(feed->fd);
+    shm_unlink(feed->name);
+    free(feed);
+}
+
+// Feed byte of a cell on either engine
+static unsigned char match_cell_state(Match *match, int player, int x, int y) {
+    if (match->small) {
+        SmallBoard *board = &match->small[player - 1];
+        int owner = board->owners[small_bit(x, y)];
+        unsigned char state = (unsigned char)(owner ? get_ship_length(board->types[owner - 1]) : 0);
+        return state | (bits_test(&board->hits, small_bit(x, y)) ? FEED_HIT : 0);
+    }
+    PlayerBoard *board = match->players[player - 1];
+    return (unsigned char)(cell_length(board, x, y) | (cell_hit(board, x, y) ? FEED_HIT : 0));
+}
+
+static void feed_status(Feed *feed, Match *match) {
+    FeedHeader *header = feed->header;
+    header->phase = match->phase;
+    header->current_player = match->current_player;
+    header->winner = match->winner;
+    header->ships_remaining[0] = match_ships_remaining(match, 1);
+    header->ships_remaining[1] = match_ships_remaining(match, 2);
+}
+
+// Start publishing a new match with empty boards. When the segment cannot
+// grow to fit them the game is published as 0 x 0, so no cell is written.
+void feed_new_game(Feed *feed, Match *match, int game, int N, int M) {
+    size_t cells = (size_t)N * M;
+    if (cells > feed->header->capacity) {
+        // Readers pick up the new capacity and remap
+        size_t capacity = feed->header->capacity;
+        while (capacity < cells && capacity <= UINT32_MAX / 2) capacity *= 2;
+        feed_begin(feed);
+        if (capacity < cells || !feed_map(feed, (uint32_t)capacity)) {
+            feed->header->game = game;
+            feed->header->N = 0;
+            feed->header->M = 0;
+            feed->header->shots = 0;
+            feed_status(feed, match);
+            feed_end(feed);
+            return;
+        }
+        feed->header->capacity = (uint32_t)capacity;
+        feed_end(feed);
+    }
+    
+    feed_begin(feed);
+    feed->header->game = game;
+    feed->header->N = N;
+    feed->header->M = M;
+    feed->header->shots = 0;
+    memset(feed->cells, 0, cells);
+    memset(feed->cells + feed->header->capacity, 0, cells);
+    feed_status(feed, match);
+    feed_end(feed);
+}
+
+// Refresh the cells of a ship that was just placed
+void feed_placement(Feed *feed, Match *match, int player, char type, char orientation, int x, int y) {
+    FeedHeader *header = feed->header;
+    unsigned char *board = feed->cells + (size_t)(player - 1) * header->capacity;
+    int length = get_ship_length(type);
+    
+    feed_begin(feed);
+    for (int i = 0; i < length; i++) {
+        int cx = (orientation == 'V') ? x - i : x;
+        int cy = (orientation == 'V') ? y : y + i;
+        if (cx < 1 || cx > header->N || cy < 1 || cy > header->M) continue;
+        board[(size_t)(cx - 1) * header->M + (cy - 1)] = match_cell_state(match, player, cx, cy);
+    }
+    feed_status(feed, match);
+    feed_end(feed);
+}
+
+// Refresh the attacked cell and the match status after a shot
+void feed_attack(Feed *feed, Match *match, int target, int x, int y) {
+    FeedHeader *header = feed->header;
+    
+    feed_begin(feed);
+    if (x >= 1 && x <= header->N && y >= 1 && y <= header->M) {
+        unsigned char *board = feed->cells + (size_t)(target - 1) * header->capacity;
+        board[(size_t)(x - 1) * header->M + (y - 1)] = match_cell_state(match, target, x, y);
+    }
+    header->shots++;
+    feed_status(feed, match);
+    feed_end(feed);
+}
+
+// ---------------------------------------------------------------------------
+// Replay with checkpoints. A game is replayed once, silently, and the
+// dynamic state of both boards (hit bits, fleet state, turn) is checkpointed
+// every REPLAY_INTERVAL shots. Seeking to shot k restores the last checkpoint
+// at or before k, found by binary search, and applies the attacks after it.
+// Ship positions never change after placement, so they are not saved.
+// Attacks applied since the last checkpoint or restore are journaled, so a
+// short step back within that stretch is undone with unmake instead.
+//
+// A full state image is kept only every REPLAY_KEYFRAME checkpoints; the
+// others hold the 64-bit words of the image that changed since the previous
+// checkpoint, which for 256 shots is a few hundred words even when the
+// image of a 1000 x 1000 game is half a megabyte.
+// ---------------------------------------------------------------------------
+
+#define REPLAY_INTERVAL 256
+#define REPLAY_KEYFRAME 64
+
+typedef struct {
+    long shot;               // Attacks applied before the checkpoint
+    MatchPhase phase;
+    int current_player;
+    int winner;
+    unsigned char *state;    // match_save_state() image on keyframes, else NULL
+    uint32_t *diff_offsets;  // Image words changed since the previous checkpoint
+    uint64_t *diff_words;
+    long diff_count;
+} ReplayCheckpoint;
+
+typedef struct {
+    GameRecord *game;
+    Match *match;            // Positioned at shot
+    long shot;
+    ReplayCheckpoint *checkpoints;
+    long checkpoint_count;
+    long checkpoint_capacity;
+    size_t state_size;       // Image bytes, a multiple of 8
+    unsigned char *image;    // Image of the last checkpoint taken
+    unsigned char *scratch;
+    AttackJournal journal;   // The last journal.count attacks before shot
+} Replay;
+
+// Bytes match_save_state() writes for this match
+static size_t match_state_size(Match *match) {
+    if (match->small) {
+        return 2 * (sizeof(Bits256) + sizeof(uint64_t) + sizeof(int));
+    }
+    PlayerBoard *board = match->players[0];
+    size_t tiles = (size_t)board->tile_rows * board->tile_cols;
+    return 2 * (tiles * sizeof(((BoardTile*)0)->hits) + (size_t)board->ship_count +
+                ((board->ship_count >> 6) + 1) * sizeof(uint64_t) + 6 * sizeof(int));
+}
+
+
+// Copy the hit and fleet state of both boards into state
+static void match_save_state(Match *match, unsigned char *state) {
+    for (int p = 0; p < 2; p++) {
+        if (match->small) {
+            SmallBoard *board = &match->small[p];
+            memcpy(state, &board->hits, sizeof(Bits256));
+            state += sizeof(Bits256);
+            memcpy(state, &board->destroyed, sizeof(uint64_t));
+            state += sizeof(uint64_t);
+            memcpy(state, &board->ships_remaining, sizeof(int));
+            state += sizeof(int);
+            continue;
+        }
+        
+        PlayerBoard *board = match->players[p];
+        size_t tiles = (size_t)board->tile_rows * board->tile_cols;
+        size_t hit_bytes = sizeof(board->tiles[0]->hits);
+        for (size_t i = 0; i < tiles; i++) {
+            if (board->tiles[i]) memcpy(state, board->tiles[i]->hits, hit_bytes);
+            else memset(state, 0, hit_bytes);
+            state += hit_bytes;
+        }
+        memcpy(state, board->fleet.hit_masks, board->ship_count);
+        state += board->ship_count;
+        size_t destroyed_bytes = ((board->ship_count >> 6) + 1) * sizeof(uint64_t);
+        memcpy(state, board->fleet.destroyed, destroyed_bytes);
+        state += destroyed_bytes;
+        memcpy(state, board->fleet.type_afloat, 5 * sizeof(int));
+        state += 5 * sizeof(int);
+        memcpy(state, &board->ships_remaining, sizeof(int));
+        state += sizeof(int);
+    }
+}
+
+// Inverse of match_save_state()
+static void match_restore_state(Match *match, const unsigned char *state) {
+    for (int p = 0; p < 2; p++) {
+        if (match->small) {
+            SmallBoard *board = &match->small[p];
+            memcpy(&board->hits, state, sizeof(Bits256));
+            state += sizeof(Bits256);
+            memcpy(&board->destroyed, state, sizeof(uint64_t));
+            state += sizeof(uint64_t);
+            memcpy(&board->ships_remaining, state, sizeof(int));
+            state += sizeof(int);
+            continue;
+        }
+        
+        PlayerBoard *board = match->players[p];
+        size_t tiles = (size_t)board->tile_rows * board->tile_cols;
+        size_t hit_bytes = sizeof(board->tiles[0]->hits);
+        static const uint64_t zero[TILE_SIZE];
+        for (size_t i = 0; i < tiles; i++) {
+            // Only tiles that differ are written, so borrowed tiles that
+            // were never hit stay shared and water tiles stay unallocated
+            const uint64_t *current = board->tiles[i] ? board->tiles[i]->hits : zero;
+            if (memcmp(current, state, hit_bytes) != 0) {
+                int x = (int)(i / board->tile_cols) * TILE_SIZE + 1;
+                int y = (int)(i % board->tile_cols) * TILE_SIZE + 1;
+                memcpy(get_tile(board, x, y)->hits, state, hit_bytes);
+            }
+            state += hit_bytes;
+        }
+        memcpy(board->fleet.hit_masks, state, board->ship_count);
+        state += board->ship_count;
+        size_t destroyed_bytes = ((board->ship_count >> 6) + 1) * sizeof(uint64_t);
+        memcpy(board->fleet.destroyed, state, destroyed_bytes);
+        state += destroyed_bytes;
+        memcpy(board->fleet.type_afloat, state, 5 * sizeof(int));
+        state += 5 * sizeof(int);
+        memcpy(&board->ships_remaining, state, sizeof(int));
+        state += sizeof(int);
+    }
+}
+
+static void replay_checkpoint(Replay *replay) {
+    if (replay->checkpoint_count == replay->checkpoint_capacity) {
+        replay->checkpoint_capacity = replay->checkpoint_capacity ? replay->checkpoint_capacity * 2 : 64;
+        replay->checkpoints = (ReplayCheckpoint*)realloc(replay->checkpoints,
+                                                         replay->checkpoint_capacity * sizeof(ReplayCheckpoint));
+    }
+    ReplayCheckpoint *checkpoint = &replay->checkpoints[replay->checkpoint_count];
+    memset(checkpoint, 0, sizeof(ReplayCheckpoint));
+    checkpoint->shot = replay->shot;
+    checkpoint->phase = replay->match->phase;
+    checkpoint->current_player = replay->match->current_player;
+    checkpoint->winner = replay->match->winner;
+    
+    match_save_state(replay->match, replay->scratch);
+    if (replay->checkpoint_count % REPLAY_KEYFRAME == 0) {
+        checkpoint->state = (unsigned char*)malloc(replay->state_size);
+        memcpy(checkpoint->state, replay->scratch, replay->state_size);
+    } else {
+        // Words that differ from the previous checkpoint
+        size_t words = replay->state_size / sizeof(uint64_t);
+        long capacity = 0;
+        for (size_t w = 0; w < words; w++) {
+            uint64_t before, after;
+            memcpy(&before, replay->image + w * sizeof(uint64_t), sizeof(uint64_t));
+            memcpy(&after, replay->scratch + w * sizeof(uint64_t), sizeof(uint64_t));
+            if (before == after) continue;
+            if (checkpoint->diff_count == capacity) {
+                capacity = capacity ? capacity * 2 : 256;
+                checkpoint->diff_offsets = (uint32_t*)realloc(checkpoint->diff_offsets, capacity * sizeof(uint32_t));
+                checkpoint->diff_words = (uint64_t*)realloc(checkpoint->diff_words, capacity * sizeof(uint64_t));
+            }
+            checkpoint->diff_offsets[checkpoint->diff_count] = (uint32_t)w;
+            checkpoint->diff_words[checkpoint->diff_count++] = after;
+        }
+    }
+    replay->checkpoint_count++;
+    
+    unsigned char *swap = replay->image;
+    replay->image = replay->scratch;
+    replay->scratch = swap;
+}
+
+// Apply the next attack of the game
+static void replay_step(Replay *replay) {
+    int *shot = replay->game->attacks[replay->shot++];
+    if (match_make_attack(replay->match, shot[0], shot[1], &replay->journal) == -2 ||
+        replay->shot % REPLAY_INTERVAL == 0) {
+        replay->journal.count = 0;  // Past a checkpoint, restoring is as cheap
+    }
+}
+
+// Place both fleets, then play the game through once taking checkpoints
+Replay* create_replay(GameRecord *game, int id) {
+    Replay *replay = (Replay*)calloc(1, sizeof(Replay));
+    replay->game = game;
+    replay->match = create_match(id, game->N, game->M, MATCH_SILENT);
+    replay->state_size = (match_state_size(replay->match) + 7) & ~(size_t)7;
+    replay->image = (unsigned char*)calloc(replay->state_size, 1);
+    replay->scratch = (unsigned char*)calloc(replay->state_size, 1);
+    
+    for (int i = 0; i < game->placement_count; i++) {
+        PlacementRecord *p = &game->placements[i];
+        match_place(replay->match, match_next_placer(replay->match), p->type, p->orientation, p->x, p->y);
+    }
+    
+    replay_checkpoint(replay);
+    while (replay->shot < game->attack_count) {
+        replay_step(replay);
+        if (replay->shot % REPLAY_INTERVAL == 0) replay_checkpoint(replay);
+    }
+    return replay;
+}
+
+void destroy_replay(Replay *replay) {
+    for (long i = 0; i < replay->checkpoint_count; i++) {
+        free(replay->checkpoints[i].state);
+        free(replay->checkpoints[i].diff_offsets);
+        free(replay->checkpoints[i].diff_words);
+    }
+    free(replay->checkpoints);
+    free(replay->image);
+    free(replay->scratch);
+    free(replay->journal.entries);
+    destroy_match(replay->match);
+    free(replay);
+}
+
+// Position the match after the first shot attacks; returns how many attacks
+// had to be applied or taken back to get there
+long replay_seek(Replay *replay, long shot) {
+    if (shot < 0) shot = 0;
+    if (shot > replay->game->attack_count) shot = replay->game->attack_count;
+    
+    if (shot < replay->shot && replay->shot - shot <= replay->journal.count) {
+        long undone = replay->shot - shot;
+        while (replay->shot > shot) {
+            match_unmake_attack(replay->match, &replay->journal);
+            replay->shot--;
+        }
+        return undone;
+    }
+    
+    // Last checkpoint at or before shot
+    long lo = 0, hi = replay->checkpoint_count - 1;
+    while (lo < hi) {
+        long mid = (lo + hi + 1) / 2;
+        if (replay->checkpoints[mid].shot <= shot) lo = mid;
+        else hi = mid - 1;
+    }
+    ReplayCheckpoint *checkpoint = &replay->checkpoints[lo];
+    
+    // Restore unless the match is already between the checkpoint and shot
+    if (replay->shot < checkpoint->shot || replay->shot > shot) {
+        // Keyframe image, then the word changes of the checkpoints after it
+        long keyframe = lo - lo % REPLAY_KEYFRAME;
+        memcpy(replay->scratch, replay->checkpoints[keyframe].state, replay->state_size);
+        for (long c = keyframe + 1; c <= lo; c++) {
+            ReplayCheckpoint *diff = &replay->checkpoints[c];
+            for (long i = 0; i < diff->diff_count; i++) {
+                memcpy(replay->scratch + (size_t)diff->diff_offsets[i] * sizeof(uint64_t),
+                       &diff->diff_words[i], sizeof(uint64_t));
+            }
+        }
+        match_restore_state(replay->match, replay->scratch);
+        replay->match->phase = checkpoint->phase;
+        replay->match->current_player = checkpoint->current_player;
+        replay->match->winner = checkpoint->winner;
+        replay->shot = checkpoint->shot;
+        replay->journal.count = 0;
+    }
+    
+    long applied = 0;
+    while (replay->shot < shot) {
+        replay_step(replay);
+        applied++;
+    }
+    return applied;
+}
+
+// Both boards as seen after the current shot: ship lengths, X for a hit
+// ship cell, o for a miss
+void replay_print(Replay *replay) {
+    Match *match = replay->match;
+    int N = replay->game->N, M = replay->game->M;
+    
+    printf("Lovitura %ld din %ld, nave rămase %d / %d", replay->shot, replay->game->attack_count,
+           match_ships_remaining(match, 1), match_ships_remaining(match, 2));
+    if (match->phase == PHASE_FINISHED) printf(", a câștigat jucătorul %d\n", match->winner);
+    else printf(", la mutare jucătorul %d\n", match->current_player);
+    
+    for (int p = 1; p <= 2; p++) {
+        for (int i = 1; i <= N; i++) {
+            for (int j = 1; j <= M; j++) {
+                unsigned char cell = match_cell_state(match, p, i, j);
+                int length = cell & FEED_LENGTH;
+                putchar((cell & FEED_HIT) ? (length ? 'X' : 'o') : '0' + length);
+                if (j < M) putchar(' ');
+            }
+            putchar('\n');
+        }
+        if (p == 1) putchar('\n');
+    }
+}
+
+// Read the text games from stdin, keep game number game (from 1) and print
+// it after each of the requested shots
+int run_replay(int game_number, char **shots, int shot_count) {
+    int J;
+    if (!read_int(stdin, &J) || game_number < 1 || game_number > J) {
+        printf("Eroare: jocul %d nu există.\n", game_number);
+        return 1;
+    }
+    
+    GameRecord game;
+    memset(&game, 0, sizeof(game));
+    for (int i = 1; i <= game_number; i++) {
+        if (!read_game(stdin, i - 1, &game)) {
+            printf("Eroare: jocul %d nu există.\n", game_number);
+            free_game_record(&game);
+            return 1;
+        }
+    }
+    
+    Replay *replay = create_replay(&game, game_number - 1);
+    for (int i = 0; i < shot_count; i++) {
+        if (i > 0) putchar('\n');
+        replay_seek(replay, atol(shots[i]));
+        replay_print(replay);
+    }
+    
+    destroy_replay(replay);
+    free_game_record(&game);
+    return 0;
+}
+
+// ---------------------------------------------------------------------------
+// Free-for-all lobby: P players, each with a board, and every shot names
+// the opponent it targets. Turns go round the players still in the game,
+// kept in a circular doubly linked list so the next player is one load and
+// an elimination is an O(1) unlink; eliminated players are never visited.
+//
+// A shot is taken in two steps. Claiming the turn (checking it and moving
+// it on) happens under the lobby lock and costs a few loads and stores;
+// resolving the shot happens under the lock of the target board only. So
+// the next player can already fire while earlier shots are being resolved,
+// and shots on different boards never wait for each other. A player whose
+// last ship sinks while their own shot is in flight keeps that shot.
+// ---------------------------------------------------------------------------
+
+#define LOBBY_MAX_PLAYERS 4096
+
+typedef struct {
+    int id;
+    int player_count;
+    int ship_count;
+    MatchPhase phase;
+    PlayerBoard **boards;     // Board of player p at p - 1
+    pthread_mutex_t *board_locks;
+    int *placed;
+    int boards_placed;        // Boards with their whole fleet
+    int *next_alive;          // Turn order of the players still in, by player
+    int *prev_alive;
+    unsigned char *eliminated;
+    int alive;
+    int current_player;
+    int winner;
+    long long shots;
+    pthread_mutex_t lock;     // Turn, placement counts and the alive list
+} Lobby;
+
+Lobby* create_lobby(int id, int player_count, int N, int M, int flags) {
+    Lobby *lobby = (Lobby*)calloc(1, sizeof(Lobby));
+    lobby->id = id;
+    lobby->player_count = player_count;
+    lobby->ship_count = calculate_total_ships(N, M);
+    lobby->boards = (PlayerBoard**)malloc(player_count * sizeof(PlayerBoard*));
+    lobby->board_locks = (pthread_mutex_t*)malloc(player_count * sizeof(pthread_mutex_t));
+    lobby->placed = (int*)calloc(player_count, sizeof(int));
+    lobby->next_alive = (int*)malloc((player_count + 1) * sizeof(int));
+    lobby->prev_alive = (int*)malloc((player_count + 1) * sizeof(int));
+    lobby->eliminated = (unsigned char*)calloc(player_count + 1, 1);
+    
+    for (int p = 1; p <= player_count; p++) {
+        lobby->boards[p - 1] = create_board(N, M, lobby->ship_count);
+        lobby->boards[p - 1]->silent = (flags & MATCH_SILENT) != 0;
+        pthread_mutex_init(&lobby->board_locks[p - 1], NULL);
+        lobby->next_alive[p] = (p == player_count) ? 1 : p + 1;
+        lobby->prev_alive[p] = (p == 1) ? player_count : p - 1;
+    }
+    pthread_mutex_init(&lobby->lock, NULL);
+    lobby->alive = player_count;
+    lobby->current_player = 1;
+    lobby->phase = (lobby->ship_count == 0) ? PHASE_ATTACK : PHASE_PLACEMENT;
+    return lobby;
+}
+
+void destroy_lobby(Lobby *lobby) {
+    if (!lobby) return;
+    for (int p = 0; p < lobby->player_count; p++) {
+        destroy_board(lobby->boards[p]);
+        pthread_mutex_destroy(&lobby->board_locks[p]);
+    }
+    pthread_mutex_destroy(&lobby->lock);
+    free(lobby->boards);
+    free(lobby->board_locks);
+    free(lobby->placed);
+    free(lobby->next_alive);
+    free(lobby->prev_alive);
+    free(lobby->eliminated);
+    free(lobby);
+}
+
+// Players place their whole fleet in turn, player 1 first
+int lobby_next_placer(Lobby *lobby) {
+    int p = 0;
+    while (p < lobby->player_count - 1 && lobby->placed[p] == lobby->ship_count) p++;
+    return p + 1;
+}
+
+// Placement of the next ship of a player; returns 1 if it was placed
+int lobby_place(Lobby *lobby, int player, char type, char orientation, int x, int y) {
+    pthread_mutex_lock(&lobby->lock);
+    int ok = lobby->phase == PHASE_PLACEMENT && player >= 1 && player <= lobby->player_count &&
+             lobby->placed[player - 1] < lobby->ship_count &&
+             place_ship(lobby->boards[player - 1], type, orientation, x, y, lobby->placed[player - 1]);
+    if (ok && ++lobby->placed[player - 1] == lobby->ship_count &&
+        ++lobby->boards_placed == lobby->player_count) {
+        lobby->phase = PHASE_ATTACK;
+    }
+    pthread_mutex_unlock(&lobby->lock);
+    return ok;
+}
+
+// Whole fleet of one player at once; see validate_fleet() for the result
+int lobby_place_fleet(Lobby *lobby, int player, ShipPlacement *fleet, int count, int *errors) {
+    if (player < 1 || player > lobby->player_count || count != lobby->ship_count) return -1;
+    
+    pthread_mutex_lock(&lobby->lock);
+    int invalid = -1;
+    if (lobby->phase == PHASE_PLACEMENT && lobby->placed[player - 1] == 0) {
+        invalid = place_fleet(lobby->boards[player - 1], fleet, count, errors);
+        if (invalid == 0) {
+            lobby->placed[player - 1] = count;
+            if (++lobby->boards_placed == lobby->player_count) lobby->phase = PHASE_ATTACK;
+        }
+    }
+    pthread_mutex_unlock(&lobby->lock);
+    return invalid;
+}
+
+// Take a player out of the turn order; caller holds the lobby lock. Once the
+// game is decided a shot still in flight eliminates no one, so the winner
+// stays the last player left.
+static void lobby_eliminate(Lobby *lobby, int player) {
+    if (lobby->phase == PHASE_FINISHED || lobby->eliminated[player]) return;
+    lobby->eliminated[player] = 1;
+    
+    int next = lobby->next_alive[player];
+    int prev = lobby->prev_alive[player];
+    lobby->next_alive[prev] = next;
+    lobby->prev_alive[next] = prev;
+    if (lobby->current_player == player) lobby->current_player = next;
+    
+    if (--lobby->alive == 1) {
+        lobby->winner = next;
+        lobby->phase = PHASE_FINISHED;
+    }
+}
+
+// Claim the turn of player against target: 1 if the shot may be fired, and
+// the turn has moved on to the next player still in, 0 otherwise
+int lobby_claim_turn(Lobby *lobby, int player, int target) {
+    pthread_mutex_lock(&lobby->lock);
+    int ok = lobby->phase == PHASE_ATTACK && player == lobby->current_player &&
+             target >= 1 && target <= lobby->player_count && target != player && !lobby->eliminated[target];
+    if (ok) {
+        lobby->current_player = lobby->next_alive[player];
+        lobby->shots++;
+    }
+    pthread_mutex_unlock(&lobby->lock);
+    return ok;
+}
+
+// Fire a claimed shot; returns the attack() result. The target leaves the
+// game when its last ship sinks.
+int lobby_resolve(Lobby *lobby, int player, int target, int x, int y) {
+    PlayerBoard *board = lobby->boards[target - 1];
+    pthread_mutex_lock(&lobby->board_locks[target - 1]);
+    int result = attack(board, x, y, player);
+    int sunk_all = board->ships_remaining == 0;
+    pthread_mutex_unlock(&lobby->board_locks[target - 1]);
+    
+    if (sunk_all) {
+        pthread_mutex_lock(&lobby->lock);
+        lobby_eliminate(lobby, target);
+        pthread_mutex_unlock(&lobby->lock);
+    }
+    return result;
+}
+
+// Shot of the player on turn; -2 if it is not accepted
+int lobby_attack(Lobby *lobby, int player, int target, int x, int y) {
+    if (!lobby_claim_turn(lobby, player, target)) return -2;
+    return lobby_resolve(lobby, player, target, x, y);
+}
+
+// Text lobbies from stdin:
+//   J, then per game P N M, P * fleet placements (player 1 first) and shots
+//   "target x y" from the player on turn until one player is left
+int run_lobby(void) {
+    int J;
+    if (scanf("%d", &J) != 1) return 1;
+    
+    for (int game = 0; game < J; game++) {
+        int P, N, M;
+        if (scanf("%d %d %d", &P, &N, &M) != 3 || P < 2 || P > LOBBY_MAX_PLAYERS) {
+            printf("Eroare: număr de jucători invalid.\n");
+            return 1;
+        }
+        Lobby *lobby = create_lobby(game, P, N, M, 0);
+        
+        while (lobby->phase == PHASE_PLACEMENT) {
+            char type, orientation;
+            int x, y;
+            if (scanf(" %c %c %d %d", &type, &orientation, &x, &y) != 4) {
+                destroy_lobby(lobby);
+                return 1;
+            }
+            if (!lobby_place(lobby, lobby_next_placer(lobby), type, orientation, x, y)) {
+                printf("Eroare: navă invalidă. Încercați din nou.\n");
+            }
+        }
+        
+        while (lobby->phase == PHASE_ATTACK) {
+            int target, x, y;
+            if (scanf("%d %d %d", &target, &x, &y) != 3) {
+                destroy_lobby(lobby);
+                return 1;
+            }
+            if (lobby_attack(lobby, lobby->current_player, target, x, y) == -2) {
+                printf("Eroare: țintă invalidă. Încercați din nou.\n");
+            } else if (lobby->eliminated[target]) {
+                // Only the shot that sinks the last ship gets here
+                printf("Jucătorul %d a fost eliminat.\n", target);
+            }
+        }
+        printf("Jucătorul %d a câștigat!\n", lobby->winner);
+        destroy_lobby(lobby);
+        if (game < J - 1) printf("\n");
+    }
+    return 0;
+}
+
+// Benchmark: lobbies of P silent players with the same packed fleet, shot
+// at random cells by thread_count threads that all play the same lobby.
+// Every thread claims whichever turn is next and fires at a random player
+// still in, so resolution overlaps across boards.
+typedef struct {
+    Lobby *lobby;
+    int N, M;
+    RngStream rng;
+    long long shots;
+} LobbyBenchTask;
+
+static void* lobby_bench_worker(void *arg) {
+    LobbyBenchTask *task = (LobbyBenchTask*)arg;
+    Lobby *lobby = task->lobby;
+    
+    for (;;) {
+        pthread_mutex_lock(&lobby->lock);
+        if (lobby->phase != PHASE_ATTACK) {
+            pthread_mutex_unlock(&lobby->lock);
+            break;
+        }
+        int player = lobby->current_player;
+        int target = 1 + (int)rng_below(&task->rng, (uint32_t)lobby->player_count);
+        if (lobby->eliminated[target] || target == player) target = lobby->next_alive[player];
+        lobby->current_player = lobby->next_alive[player];
+        lobby->shots++;
+        pthread_mutex_unlock(&lobby->lock);
+        
+        // Target may be taken out meanwhile; the shot then hits a sunk fleet
+        int x = 1 + (int)rng_below(&task->rng, (uint32_t)task->N);
+        int y = 1 + (int)rng_below(&task->rng, (uint32_t)task->M);
+        lobby_resolve(lobby, player, target, x, y);
+        task->shots++;
+    }
+    return NULL;
+}
+
+int run_lobby_bench(int P, int N, int M, int thread_count, int lobby_count) {
+    if (P < 2 || P > LOBBY_MAX_PLAYERS || N < 1 || M < 1 || lobby_count < 1) {
+        printf("Utilizare: --lobby-bench P N M [fire] [loburi]\n");
+        return 1;
+    }
+    if (thread_count <= 0) thread_count = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (thread_count < 1) thread_count = 1;
+    
+    int counts[5];
+    quota_counts(N, M, counts);
+    int total = calculate_total_ships(N, M);
+    ShipPlacement *fleet = (ShipPlacement*)malloc((total + 1) * sizeof(ShipPlacement));
+    int *errors = (int*)malloc((total + 1) * sizeof(int));
+    if (solve_fleet(N, M, counts, 1000, fleet) != FEASIBLE_YES) {
+        printf("Eroare: flota nu încape pe tabla %dx%d.\n", N, M);
+        free(fleet);
+        free(errors);
+        return 1;
+    }
+    
+    LobbyBenchTask *tasks = (LobbyBenchTask*)calloc(thread_count, sizeof(LobbyBenchTask));
+    pthread_t *threads = (pthread_t*)malloc(thread_count * sizeof(pthread_t));
+    long long shots = 0;
+    double seconds = 0;
+    
+    for (int l = 0; l < lobby_count; l++) {
+        Lobby *lobby = create_lobby(l, P, N, M, MATCH_SILENT);
+        for (int p = 1; p <= P && total > 0; p++) {
+            lobby_place_fleet(lobby, p, fleet, total, errors);
+        }
+        
+        struct timespec start, end;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        for (int t = 0; t < thread_count; t++) {
+            tasks[t].lobby = lobby;
+            tasks[t].N = N;
+            tasks[t].M = M;
+            tasks[t].rng.key = mix64(((uint64_t)l << 32) | (uint64_t)t);
+            tasks[t].shots = 0;
+            pthread_create(&threads[t], NULL, lobby_bench_worker, &tasks[t]);
+        }
+        for (int t = 0; t < thread_count; t++) {
+            pthread_join(threads[t], NULL);
+            shots += tasks[t].shots;
+        }
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        seconds += (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+        destroy_lobby(lobby);
+    }
+    
+    printf("%d jucători, tabla %dx%d, %d fire, %d loburi: %lld lovituri în %.3f s, %.0f lovituri/s\n",
+           P, N, M, thread_count, lobby_count, shots, seconds, seconds > 0 ? shots / seconds : 0.0);
+    free(tasks);
+    free(threads);
+    free(fleet);
+    free(errors);
+    return 0;
+}
+
+// ---------------------------------------------------------------------------
+// Bot tournament. A bot is a shooter paired with a fleet placer. Every
+// ordered pair of different bots plays one game per seed, and the games run
+// on a work-stealing pool: each worker owns a range of game numbers and
+// takes from its front, and an idle worker splits off the back half of
+// someone else's range. Workers keep their boards and scratch buffers
+// across games and count into their own results, summed after the join.
+//
+// Seeds only depend on the bot, the role and the seed number, so a bot
+// places the same fleet and shoots in the same order against every
+// opponent, and the results do not depend on the thread count.
+// ---------------------------------------------------------------------------
+
+#define SHOOTER_LINE   0   // Row by row
+#define SHOOTER_RANDOM 1   // Random order
+#define SHOOTER_HUNT   2   // Random order, neighbours of a hit first
+#define SHOOTER_COUNT  3
+
+#define PLACER_RANDOM  0   // Uniform placements
+#define PLACER_EDGE    1   // Best of a few placements, closest to the border
+#define PLACER_PACKED  2   // Packed solve_fleet() layout, randomly mirrored
+#define PLACER_COUNT   3
+
+#define BOT_COUNT (SHOOTER_COUNT * PLACER_COUNT)
+#define PLACER_TRIES 1000  // Random placements per ship before starting over
+#define EDGE_CANDIDATES 8
+
+static const char *shooter_names[SHOOTER_COUNT] = {"linie", "aleator", "vanator"};
+static const char *placer_names[PLACER_COUNT] = {"aleator", "margine", "compact"};
+
+// Per thread totals, one cache line aligned block per worker
+typedef struct {
+    _Alignas(64) long long games[BOT_COUNT];
+    long long wins[BOT_COUNT];
+    long long shots[BOT_COUNT];                           // Shots to sink the other fleet
+    long long matchup_shots[SHOOTER_COUNT][PLACER_COUNT]; // Same, by shooter and opponent placer
+    long long matchup_games[SHOOTER_COUNT][PLACER_COUNT];
+    long long steals;
+} TournamentResults;
+
+// Game numbers [begin, end) of one worker, packed as begin << 32 | end
+typedef struct {
+    _Alignas(64) _Atomic uint64_t range;
+} WorkRange;
+
+typedef struct {
+    int N, M;
+    int ship_count;
+    int seeds;
+    uint64_t seed;
+    const ShipPlacement *packed;
+    WorkRange *ranges;
+    int thread_count;
+} Tournament;
+
+typedef struct {
+    Tournament *tournament;
+    int index;
+    TournamentResults *results;
+    // Pool reused by every game of the worker
+    PlayerBoard *boards[2];
+    ShipPlacement *fleet;
+    int *errors;
+    unsigned char *occupied;
+    unsigned char *shot;
+    int *order;
+    int *targets;
+} TournamentWorker;
+
+static int take_game(WorkRange *range, uint32_t *game) {
+    uint64_t r = atomic_load_explicit(&range->range, memory_order_relaxed);
+    for (;;) {
+        uint32_t begin = (uint32_t)(r >> 32), end = (uint32_t)r;
+        if (begin >= end) return 0;
+        if (atomic_compare_exchange_weak(&range->range, &r, ((uint64_t)(begin + 1) << 32) | end)) {
+            *game = begin;
+            return 1;
+        }
+    }
+}
+
+// Move the back half of a victim's range (all of it if only one game is
+// left) into the thief's empty range
+static int steal_games(WorkRange *victim, WorkRange *thief) {
+    uint64_t r = atomic_load_explicit(&victim->range, memory_order_relaxed);
+    for (;;) {
+        uint32_t begin = (uint32_t)(r >> 32), end = (uint32_t)r;
+        if (begin >= end) return 0;
+        uint32_t middle = begin + (end - begin) / 2;
+        if (atomic_compare_exchange_weak(&victim->range, &r, ((uint64_t)begin << 32) | middle)) {
+            atomic_store(&thief->range, ((uint64_t)middle << 32) | end);
+            return 1;
+        }
+    }
+}
+
+static RngStream bot_rng(Tournament *tournament, int bot, int role, int seed) {
+    RngStream rng = {mix64(tournament->seed ^ mix64(((uint64_t)bot << 40) | ((uint64_t)role << 32) | (uint32_t)seed)), 0};
+    return rng;
+}
+
+// Cells of a ship are free on the occupancy grid
+static int ship_fits(TournamentWorker *worker, ShipPlacement *ship) {
+    int M = worker->tournament->M;
+    int length = get_ship_length(ship->type);
+    for (int k = 0; k < length; k++) {
+        int x = (ship->orientation == 'H') ? ship->x : ship->x - k;
+        int y = (ship->orientation == 'H') ? ship->y + k : ship->y;
+        if (worker->occupied[(size_t)(x - 1) * M + (y - 1)]) return 0;
+    }
+    return 1;
+}
+
+static void mark_ship(TournamentWorker *worker, ShipPlacement *ship) {
+    int M = worker->tournament->M;
+    int length = get_ship_length(ship->type);
+    for (int k = 0; k < length; k++) {
+        int x = (ship->orientation == 'H') ? ship->x : ship->x - k;
+        int y = (ship->orientation == 'H') ? ship->y + k : ship->y;
+        worker->occupied[(size_t)(x - 1) * M + (y - 1)] = 1;
+    }
+}
+
+// Uniform in-bounds placement of a ship of the given type
+static void random_ship(Tournament *tournament, RngStream *rng, char type, ShipPlacement *ship) {
+    int length = get_ship_length(type);
+    int N = tournament->N, M = tournament->M;
+    ship->type = type;
+    ship->orientation = (length > 1 && rng_below(rng, 2)) ? 'V' : 'H';
+    if (length > M) ship->orientation = 'V';  // Only one way fits
+    if (length > N) ship->orientation = 'H';
+    if (ship->orientation == 'H') {
+        ship->x = 1 + (int)rng_below(rng, (uint32_t)N);
+        ship->y = 1 + (int)rng_below(rng, (uint32_t)(M - length + 1));
+    } else {
+        ship->x = length + (int)rng_below(rng, (uint32_t)(N - length + 1));
+        ship->y = 1 + (int)rng_below(rng, (uint32_t)M);
+    }
+}
+
+// Distance from the ship's nearest end to the border
+static int border_distance(Tournament *tournament, ShipPlacement *ship) {
+    int length = get_ship_length(ship->type);
+    int x2 = (ship->orientation == 'H') ? ship->x : ship->x - length + 1;
+    int y2 = (ship->orientation == 'H') ? ship->y + length - 1 : ship->y;
+    int d = ship->x - 1;
+    if (tournament->N - ship->x < d) d = tournament->N - ship->x;
+    if (x2 - 1 < d) d = x2 - 1;
+    if (ship->y - 1 < d) d = ship->y - 1;
+    if (tournament->M - y2 < d) d = tournament->M - y2;
+    return d;
+}
+
+// Fleet of the placer into worker->fleet; any placement it cannot finish
+// falls back to the packed layout
+static void place_bot_fleet(TournamentWorker *worker, int placer, RngStream *rng) {
+    Tournament *tournament = worker->tournament;
+    int N = tournament->N, M = tournament->M;
+    
+    int wanted = (placer == PLACER_EDGE) ? EDGE_CANDIDATES : 1;
+    for (int attempt = 0; placer != PLACER_PACKED && attempt < 100; attempt++) {
+        memset(worker->occupied, 0, (size_t)N * M);
+        int placed = 0;
+        for (int t = 0; t < 5 && placed >= 0; t++) {
+            char type = "SYBLA"[t];
+            for (int k = calculate_ships_per_type(N, M, type); k > 0 && placed >= 0; k--) {
+                ShipPlacement best, ship;
+                int best_distance = 0, candidates = 0;
+                for (int tries = 0; tries < PLACER_TRIES && candidates < wanted; tries++) {
+                    random_ship(tournament, rng, type, &ship);
+                    if (!ship_fits(worker, &ship)) continue;
+                    int distance = (placer == PLACER_EDGE) ? border_distance(tournament, &ship) : 0;
+                    if (candidates++ == 0 || distance < best_distance) {
+                        best = ship;
+                        best_distance = distance;
+                    }
+                }
+                if (candidates == 0) {
+                    placed = -1;  // Boxed in, start over
+                } else {
+                    mark_ship(worker, &best);
+                    worker->fleet[placed++] = best;
+                }
+            }
+        }
+        if (placed >= 0) return;
+    }
+    
+    // Packed layout, mirrored top to bottom and left to right at random
+    int flip_x = (int)rng_below(rng, 2), flip_y = (int)rng_below(rng, 2);
+    for (int i = 0; i < tournament->ship_count; i++) {
+        ShipPlacement ship = tournament->packed[i];
+        int length = get_ship_length(ship.type);
+        if (ship.orientation == 'H') {
+            if (flip_x) ship.x = N + 1 - ship.x;
+            if (flip_y) ship.y = M + 2 - ship.y - length;
+        } else {
+            if (flip_x) ship.x = N + length - ship.x;
+            if (flip_y) ship.y = M + 1 - ship.y;
+        }
+        worker->fleet[i] = ship;
+    }
+}
+
+// Shoot at the board until its fleet is gone or every cell has been shot;
+// returns the shots fired
+static long long play_shooter(TournamentWorker *worker, int shooter, PlayerBoard *board, RngStream *rng) {
+    int N = worker->tournament->N, M = worker->tournament->M;
+    int cells = N * M;
+    int *order = worker->order;
+    
+    memset(worker->shot, 0, (size_t)cells);
+    for (int c = 0; c < cells; c++) order[c] = c;
+    if (shooter != SHOOTER_LINE) {
+        for (int c = cells - 1; c > 0; c--) {
+            int other = (int)rng_below(rng, (uint32_t)(c + 1));
+            int swap = order[c];
+            order[c] = order[other];
+            order[other] = swap;
+        }
+    }
+    
+    long long shots = 0;
+    int next = 0, target_count = 0;
+    while (board->ships_remaining > 0) {
+        int cell = -1;
+        while (target_count > 0 && cell < 0) {
+            int candidate = worker->targets[--target_count];
+            if (!worker->shot[candidate]) cell = candidate;
+        }
+        while (cell < 0 && next < cells) {
+            if (!worker->shot[order[next]]) cell = order[next];
+            next++;
+        }
+        if (cell < 0) break;
+        
+        worker->shot[cell] = 1;
+        int x = cell / M + 1, y = cell % M + 1;
+        int result = attack(board, x, y, 0);
+        shots++;
+        
+        // Hit without a sink: the rest of the ship is next to it
+        if (shooter == SHOOTER_HUNT && result == 1) {
+            if (x > 1 && !worker->shot[cell - M]) worker->targets[target_count++] = cell - M;
+            if (x < N && !worker->shot[cell + M]) worker->targets[target_count++] = cell + M;
+            if (y > 1 && !worker->shot[cell - 1]) worker->targets[target_count++] = cell - 1;
+            if (y < M && !worker->shot[cell + 1]) worker->targets[target_count++] = cell + 1;
+        }
+    }
+    return shots;
+}
+
+// Game number -> bots and seed: pairs (a, b) with a != b, seeds innermost
+static void play_tournament_game(TournamentWorker *worker, uint32_t game) {
+    Tournament *tournament = worker->tournament;
+    TournamentResults *results = worker->results;
+    int seed = (int)(game % tournament->seeds);
+    int pair = (int)(game / tournament->seeds);
+    int bots[2];
+    bots[0] = pair / (BOT_COUNT - 1);
+    bots[1] = pair % (BOT_COUNT - 1);
+    if (bots[1] >= bots[0]) bots[1]++;
+    
+    for (int p = 0; p < 2; p++) {
+        RngStream rng = bot_rng(tournament, bots[p], 0, seed);
+        reset_board(worker->boards[p]);
+        place_bot_fleet(worker, bots[p] % PLACER_COUNT, &rng);
+        if (place_fleet(worker->boards[p], worker->fleet, tournament->ship_count, worker->errors) != 0) {
+            // A placer bug must not leave a half-empty board: use the checked layout
+            memcpy(worker->fleet, tournament->packed, (size_t)tournament->ship_count * sizeof(ShipPlacement));
+            place_fleet(worker->boards[p], worker->fleet, tournament->ship_count, worker->errors);
+        }
+    }
+    
+    // A shot only changes the opponent's board, so playing each side out in
+    // turn gives the same winner as alternating: the first player wins ties
+    long long shots[2];
+    for (int p = 0; p < 2; p++) {
+        RngStream rng = bot_rng(tournament, bots[p], 1, seed);
+        int shooter = bots[p] / PLACER_COUNT;
+        int placer = bots[1 - p] % PLACER_COUNT;
+        shots[p] = play_shooter(worker, shooter, worker->boards[1 - p], &rng);
+        results->games[bots[p]]++;
+        results->shots[bots[p]] += shots[p];
+        results->matchup_shots[shooter][placer] += shots[p];
+        results->matchup_games[shooter][placer]++;
+    }
+    results->wins[bots[shots[0] <= shots[1] ? 0 : 1]]++;
+}
+
+static void* tournament_worker(void *arg) {
+    TournamentWorker *worker = (TournamentWorker*)arg;
+    Tournament *tournament = worker->tournament;
+    WorkRange *own = &tournament->ranges[worker->index];
+    
+    for (;;) {
+        uint32_t game;
+        while (take_game(own, &game)) {
+            play_tournament_game(worker, game);
+        }
+        
+        // Out of work: steal, starting from the next worker round the ring
+        int stolen = 0;
+        for (int k = 1; k < tournament->thread_count && !stolen; k++) {
+            stolen = steal_games(&tournament->ranges[(worker->index + k) % tournament->thread_count], own);
+        }
+        if (!stolen) break;
+        worker->results->steals++;
+    }
+    return NULL;
+}
+
+static double bot_win_rate(TournamentResults *total, int bot) {
+    return total->games[bot] ? (double)total->wins[bot] / total->games[bot] : 0.0;
+}
+
+// Play every ordered pair of bots once per seed on an N x M board and print
+// the standings as CSV, the timing on stderr
+int run_tournament(int N, int M, int seeds, int thread_count, uint64_t seed) {
+    long long game_count = (long long)BOT_COUNT * (BOT_COUNT - 1) * seeds;
+    if (N < 1 || M < 1 || seeds < 1 || (long long)N * M > (1 << 24) || game_count > UINT32_MAX) {
+        printf("Utilizare: --tournament N M seminte [fire] [seed]\n");
+        return 1;
+    }
+    int counts[5];
+    quota_counts(N, M, counts);
+    int total_ships = calculate_total_ships(N, M);
+    if (thread_count <= 0) thread_count = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (thread_count < 1) thread_count = 1;
+    
+    ShipPlacement *packed = (ShipPlacement*)malloc((total_ships + 1) * sizeof(ShipPlacement));
+    if (solve_fleet(N, M, counts, 1000, packed) != FEASIBLE_YES) {
+        printf("Eroare: flota nu încape pe tabla %dx%d.\n", N, M);
+        free(packed);
+        return 1;
+    }
+    
+    Tournament tournament = {N, M, total_ships, seeds, seed, packed, NULL, thread_count};
+    tournament.ranges = (WorkRange*)aligned_calloc(thread_count * sizeof(WorkRange));
+    TournamentResults *results = (TournamentResults*)aligned_calloc(thread_count * sizeof(TournamentResults));
+    TournamentWorker *workers = (TournamentWorker*)calloc(thread_count, sizeof(TournamentWorker));
+    pthread_t *threads = (pthread_t*)malloc(thread_count * sizeof(pthread_t));
+    
+    for (int t = 0; t < thread_count; t++) {
+        uint64_t begin = (uint64_t)game_count * t / thread_count;
+        uint64_t end = (uint64_t)game_count * (t + 1) / thread_count;
+        atomic_init(&tournament.ranges[t].range, (begin << 32) | end);
+        
+        TournamentWorker *worker = &workers[t];
+        worker->tournament = &tournament;
+        worker->index = t;
+        worker->results = &results[t];
+        worker->boards[0] = create_board(N, M, total_ships);
+        worker->boards[1] = create_board(N, M, total_ships);
+        worker->boards[0]->silent = worker->boards[1]->silent = 1;
+        worker->fleet = (ShipPlacement*)malloc((total_ships + 1) * sizeof(ShipPlacement));
+        worker->errors = (int*)malloc((total_ships + 1) * sizeof(int));
+        worker->occupied = (unsigned char*)malloc((size_t)N * M);
+        worker->shot = (unsigned char*)malloc((size_t)N * M);
+        worker->order = (int*)malloc((size_t)N * M * sizeof(int));
+        worker->targets = (int*)malloc((size_t)N * M * 4 * sizeof(int));
+    }
+    
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int t = 0; t < thread_count; t++) {
+        pthread_create(&threads[t], NULL, tournament_worker, &workers[t]);
+    }
+    for (int t = 0; t < thread_count; t++) {
+        pthread_join(threads[t], NULL);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    
+    // Sum the per thread results into the first block
+    TournamentResults *total = &results[0];
+    for (int t = 1; t < thread_count; t++) {
+        for (int b = 0; b < BOT_COUNT; b++) {
+            total->games[b] += results[t].games[b];
+            total->wins[b] += results[t].wins[b];
+            total->shots[b] += results[t].shots[b];
+        }
+        for (int s = 0; s < SHOOTER_COUNT; s++) {
+            for (int p = 0; p < PLACER_COUNT; p++) {
+                total->matchup_shots[s][p] += results[t].matchup_shots[s][p];
+                total->matchup_games[s][p] += results[t].matchup_games[s][p];
+            }
+        }
+        total->steals += results[t].steals;
+    }
+    
+    // Best win rate first
+    int ranking[BOT_COUNT];
+    for (int b = 0; b < BOT_COUNT; b++) {
+        int i = b;
+        while (i > 0 && bot_win_rate(total, ranking[i - 1]) < bot_win_rate(total, b)) {
+            ranking[i] = ranking[i - 1];
+            i--;
+        }
+        ranking[i] = b;
+    }
+    
+    printf("bot,shooter,placer,games,wins,win_rate,mean_shots\n");
+    for (int i = 0; i < BOT_COUNT; i++) {
+        int b = ranking[i];
+        printf("%d,%s,%s,%lld,%lld,%.4f,%.2f\n", b, shooter_names[b / PLACER_COUNT], placer_names[b % PLACER_COUNT],
+               total->games[b], total->wins[b], bot_win_rate(total, b),
+               total->games[b] ? (double)total->shots[b] / total->games[b] : 0.0);
+    }
+    printf("\nshooter,placer,games,mean_shots\n");
+    for (int s = 0; s < SHOOTER_COUNT; s++) {
+        for (int p = 0; p < PLACER_COUNT; p++) {
+            printf("%s,%s,%lld,%.2f\n", shooter_names[s], placer_names[p], total->matchup_games[s][p],
+                   total->matchup_games[s][p] ? (double)total->matchup_shots[s][p] / total->matchup_games[s][p] : 0.0);
+        }
+    }
+    fprintf(stderr, "%lld jocuri pe tabla %dx%d, %d fire, %lld furturi, %.3f s, %.0f jocuri/s\n",
+            game_count, N, M, thread_count, total->steals, seconds, seconds > 0 ? game_count / seconds : 0.0);
+    
+    for (int t = 0; t < thread_count; t++) {
+        TournamentWorker *worker = &workers[t];
+        destroy_board(worker->boards[0]);
+        destroy_board(worker->boards[1]);
+        free(worker->fleet);
+        free(worker->errors);
+        free(worker->occupied);
+        free(worker->shot);
+        free(worker->order);
+        free(worker->targets);
+    }
+    free(workers);
+    free(threads);
+    free(results);
+    free(tournament.ranges);
+    free(packed);
+    return 0;
+}
+
+// ---------------------------------------------------------------------------
+// Exact endgame solver. On a small board the player on turn has seen some
+// misses and hits and knows which ship types are still afloat, and every
+// fleet of those ships that agrees with what was seen is equally likely.
+// The solver finds the least expected number of shots to sink them all.
+//
+// A shot reports a miss, a hit on type t or a sunk type t (head hit), and
+// splits the fleets still possible by that outcome. The remains of a sunk
+// ship read as water, so the order of the shots matters and the hits,
+// misses and remaining types alone do not fix what is still possible. The
+// state is the multiset of afloat parts of the possible fleets plus the
+// shots on cells they cover, hashed with Zobrist keys: a random word per
+// ship placement and per cell, XORed within a fleet, and the fleets summed
+// so that fleets differing only in where a sunk ship lay count twice.
+// Values go to a lock-free transposition table shared by all threads, which
+// split the candidate first shots between them. The search is exponential in
+// the worst case, so it runs against a time budget like solve_fleet().
+//
+// At the start, hits on ships that are already sunk count as seen hits of
+// their type. An afloat ship may cover any seen hit of its type, and a seen
+// hit of a type with no sunk ship must be covered.
+// ---------------------------------------------------------------------------
+
+#define ENDGAME_MAX_SHIPS 8
+#define ENDGAME_MAX_CELLS (ENDGAME_MAX_SHIPS * 5)
+#define ENDGAME_MAX_WORLDS (1 << 18)
+#define ENDGAME_OUTCOMES 11   // Miss, hit on type t (1 + t), sunk type t (6 + t)
+#define ENDGAME_TABLE_BITS 21
+
+#define SEEN_UNKNOWN 0
+#define SEEN_MISS    1        // Also the head of a sunk ship: nothing else fits there
+#define SEEN_HIT     2        // SEEN_HIT + t: hit on a ship of type t
+
+// One possible fleet of the afloat ships
+typedef struct {
+    unsigned char cell_count;
+    unsigned char heads[ENDGAME_MAX_SHIPS];   // Head cell of each ship
+    unsigned short placements[ENDGAME_MAX_SHIPS];
+    unsigned char cells[ENDGAME_MAX_CELLS];   // Cells covered by the fleet
+    unsigned char codes[ENDGAME_MAX_CELLS];   // Ship + 1, | 0x80 on its head
+} EndgameFleet;
+
+typedef struct {
+    int N, M, cells;
+    int ship_count;                 // Afloat ships, in S Y B L A order
+    char types[ENDGAME_MAX_SHIPS];
+    EndgameFleet *fleets;
+    long fleet_count;
+    long fleet_capacity;
+    int too_many;
+    uint64_t *placement_keys;
+    uint64_t cell_keys[SMALL_BOARD_SIZE * SMALL_BOARD_SIZE];
+    unsigned char seen[SMALL_BOARD_SIZE * SMALL_BOARD_SIZE];
+    Bits256 shots;                  // Cells shot before the endgame
+    _Atomic uint64_t *table;        // Entry pairs (key ^ value, value)
+    uint64_t table_mask;
+    _Atomic uint64_t best;          // Root bound, bits of a double
+    struct timespec deadline;
+    atomic_int timed_out;
+} Endgame;
+
+// What the player on turn has seen of the cell (x, y) of target
+static int endgame_seen(Match *match, int target, int x, int y) {
+    int hit, ship, head, sunk;
+    char type;
+    if (match->small) {
+        SmallBoard *board = &match->small[target - 1];
+        int bit = small_bit(x, y);
+        hit = bits_test(&board->hits, bit);
+        ship = board->owners[bit] - 1;
+        if (ship < 0) return hit ? SEEN_MISS : SEEN_UNKNOWN;
+        type = board->types[ship];
+        head = board->heads[ship] == bit;
+        sunk = (board->destroyed >> ship) & 1;
+    } else {
+        PlayerBoard *board = match->players[target - 1];
+        hit = cell_hit(board, x, y);
+        ship = cell_owner(board, x, y) - 1;
+        if (ship < 0) return hit ? SEEN_MISS : SEEN_UNKNOWN;
+        type = board->fleet.types[ship];
+        head = board->fleet.start_x[ship] == x && board->fleet.start_y[ship] == y;
+        sunk = ship_destroyed(&board->fleet, ship);
+    }
+    if (!hit) return SEEN_UNKNOWN;
+    return (sunk && head) ? SEEN_MISS : SEEN_HIT + type_index(type);
+}
+
+static void endgame_add_fleet(Endgame *eg, const unsigned short *ships, int (*placements)[2]) {
+    if (eg->fleet_count == ENDGAME_MAX_WORLDS) {
+        eg->too_many = 1;
+        return;
+    }
+    if (eg->fleet_count == eg->fleet_capacity) {
+        eg->fleet_capacity = eg->fleet_capacity ? eg->fleet_capacity * 2 : 1024;
+        eg->fleets = (EndgameFleet*)realloc(eg->fleets, eg->fleet_capacity * sizeof(EndgameFleet));
+    }
+    EndgameFleet *fleet = &eg->fleets[eg->fleet_count++];
+    fleet->cell_count = 0;
+    for (int k = 0; k < eg->ship_count; k++) {
+        int length = get_ship_length(eg->types[k]);
+        int x = placements[ships[k]][0] >> 8, y = placements[ships[k]][0] & 0xFF;
+        int vertical = placements[ships[k]][1];
+        fleet->heads[k] = (unsigned char)((x - 1) * eg->M + (y - 1));
+        fleet->placements[k] = ships[k];
+        for (int i = 0; i < length; i++) {
+            int c = vertical ? (x - i - 1) * eg->M + (y - 1) : (x - 1) * eg->M + (y + i - 1);
+            fleet->cells[fleet->cell_count] = (unsigned char)c;
+            fleet->codes[fleet->cell_count++] = (unsigned char)((k + 1) | (i == 0 ? 0x80 : 0));
+        }
+    }
+}
+
+// Place afloat ship k onwards; ships of one type take placements in
+// increasing order so each fleet is listed once
+static void endgame_enumerate(Endgame *eg, int (*placements)[2], Bits256 *masks, int *first_of_type,
+                              int *placement_count, unsigned short *ships, int k, int first,
+                              Bits256 *used, const Bits256 *must_cover) {
+    if (eg->too_many) return;
+    if (k == eg->ship_count) {
+        for (int w = 0; w < 4; w++) {
+            if (must_cover->w[w] & ~used->w[w]) return;
+        }
+        endgame_add_fleet(eg, ships, placements);
+        return;
+    }
+    int t = type_index(eg->types[k]);
+    int start = (k > 0 && eg->types[k - 1] == eg->types[k]) ? first + 1 : first_of_type[t];
+    for (int p = start; p < first_of_type[t] + placement_count[t]; p++) {
+        if (bits_intersect(&masks[p], used)) continue;
+        ships[k] = (unsigned short)p;
+        for (int w = 0; w < 4; w++) used->w[w] |= masks[p].w[w];
+        endgame_enumerate(eg, placements, masks, first_of_type, placement_count, ships, k + 1, p,
+                          used, must_cover);
+        for (int w = 0; w < 4; w++) used->w[w] &= ~masks[p].w[w];
+    }
+}
+
+// Build the fleets still possible for the player on turn; 0 if the board or
+// the endgame is too big
+int init_endgame(Endgame *eg, Match *match) {
+    int target = 3 - match->current_player;
+    memset(eg, 0, sizeof(Endgame));
+    eg->N = match->small ? match->small[0].N : match->players[0]->N;
+    eg->M = match->small ? match->small[0].M : match->players[0]->M;
+    eg->cells = eg->N * eg->M;
+    if (eg->N > SMALL_BOARD_SIZE || eg->M > SMALL_BOARD_SIZE) return 0;
+    
+    // Afloat ships, and the types with at least one sunk ship
+    int sunk_of_type[5] = {0};
+    int count = match->small ? match->small[target - 1].ship_count : match->players[target - 1]->ship_count;
+    for (int t = 0; t < 5; t++) {
+        for (int k = 0; k < count; k++) {
+            char type;
+            int sunk;
+            if (match->small) {
+                type = match->small[target - 1].types[k];
+                sunk = (match->small[target - 1].destroyed >> k) & 1;
+            } else {
+                type = match->players[target - 1]->fleet.types[k];
+                sunk = ship_destroyed(&match->players[target - 1]->fleet, k);
+            }
+            if (type_index(type) != t) continue;
+            if (sunk) {
+                sunk_of_type[t]++;
+            } else {
+                if (eg->ship_count == ENDGAME_MAX_SHIPS) return 0;
+                eg->types[eg->ship_count++] = type;
+            }
+        }
+    }
+    
+    Bits256 must_cover;
+    memset(&must_cover, 0, sizeof(must_cover));
+    for (int x = 1; x <= eg->N; x++) {
+        for (int y = 1; y <= eg->M; y++) {
+            int c = (x - 1) * eg->M + (y - 1);
+            eg->seen[c] = (unsigned char)endgame_seen(match, target, x, y);
+            if (eg->seen[c] != SEEN_UNKNOWN) bits_set(&eg->shots, c);
+            if (eg->seen[c] >= SEEN_HIT && sunk_of_type[eg->seen[c] - SEEN_HIT] == 0) bits_set(&must_cover, c);
+        }
+    }
+    
+    // Single ship placements that agree with what was seen, grouped by type
+    int (*placements)[2] = (int (*)[2])malloc(5 * 2 * (size_t)eg->cells * sizeof(*placements));
+    Bits256 *masks = (Bits256*)malloc(5 * 2 * (size_t)eg->cells * sizeof(Bits256));
+    int first_of_type[5], placement_count[5], total = 0;
+    for (int t = 0; t < 5; t++) {
+        first_of_type[t] = total;
+        placement_count[t] = 0;
+        int length = get_ship_length(feasible_types[t]);
+        for (int x = 1; x <= eg->N; x++) {
+            for (int y = 1; y <= eg->M; y++) {
+                for (int vertical = 0; vertical < 2; vertical++) {
+                    if (vertical ? x - length + 1 < 1 : y + length - 1 > eg->M) continue;
+                    if (length == 1 && vertical) continue;
+                    
+                    Bits256 mask;
+                    memset(&mask, 0, sizeof(mask));
+                    int ok = 1;
+                    for (int i = 0; i < length && ok; i++) {
+                        int c = vertical ? (x - i - 1) * eg->M + (y - 1) : (x - 1) * eg->M + (y + i - 1);
+                        // Heads are never shot, other cells are unknown or hits of this type
+                        ok = eg->seen[c] == SEEN_UNKNOWN || (i > 0 && eg->seen[c] == SEEN_HIT + t);
+                        bits_set(&mask, c);
+                    }
+                    if (!ok) continue;
+                    placements[total][0] = (x << 8) | y;
+                    placements[total][1] = vertical;
+                    masks[total++] = mask;
+                    placement_count[t]++;
+                }
+            }
+        }
+    }
+    
+    unsigned short ships[ENDGAME_MAX_SHIPS];
+    Bits256 used;
+    memset(&used, 0, sizeof(used));
+    endgame_enumerate(eg, placements, masks, first_of_type, placement_count, ships, 0, 0, &used, &must_cover);
+    free(placements);
+    free(masks);
+    if (eg->too_many) return 0;
+    
+    RngStream rng = {0xE5D6A3EULL, 0};
+    eg->placement_keys = (uint64_t*)malloc((total + 1) * sizeof(uint64_t));
+    for (int p = 0; p < total; p++) {
+        eg->placement_keys[p] = mix64(rng.key + 0x9E3779B97F4A7C15ULL * ++rng.counter);
+    }
+    for (int c = 0; c < eg->cells; c++) {
+        eg->cell_keys[c] = mix64(rng.key + 0x9E3779B97F4A7C15ULL * ++rng.counter);
+    }
+    eg->table_mask = ((uint64_t)1 << ENDGAME_TABLE_BITS) - 1;
+    eg->table = (_Atomic uint64_t*)calloc(2 * ((size_t)eg->table_mask + 1), sizeof(uint64_t));
+    return 1;
+}
+
+void free_endgame(Endgame *eg) {
+    free(eg->fleets);
+    free(eg->placement_keys);
+    free((void*)eg->table);
+}
+
+// Lock-free table: a torn pair fails the key check and reads as a miss
+static int endgame_probe(Endgame *eg, uint64_t key, double *value) {
+    _Atomic uint64_t *entry = &eg->table[2 * (key & eg->table_mask)];
+    uint64_t check = atomic_load_explicit(&entry[0], memory_order_relaxed);
+    uint64_t bits = atomic_load_explicit(&entry[1], memory_order_relaxed);
+    if ((check ^ bits) != key) return 0;
+    memcpy(value, &bits, sizeof(double));
+    return 1;
+}
+
+static void endgame_store(Endgame *eg, uint64_t key, double value) {
+    _Atomic uint64_t *entry = &eg->table[2 * (key & eg->table_mask)];
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(double));
+    atomic_store_explicit(&entry[0], key ^ bits, memory_order_relaxed);
+    atomic_store_explicit(&entry[1], bits, memory_order_relaxed);
+}
+
+static inline int endgame_outcome(Endgame *eg, const EndgameFleet *fleet, int c, const Bits256 *shots) {
+    for (int i = 0; i < fleet->cell_count; i++) {
+        if (fleet->cells[i] != c) continue;
+        int ship = (fleet->codes[i] & 0x7F) - 1;
+        if (bits_test(shots, fleet->heads[ship])) return 0;  // Remains of a sunk ship
+        int t = type_index(eg->types[ship]);
+        return (fleet->codes[i] & 0x80) ? 6 + t : 1 + t;
+    }
+    return 0;
+}
+
+typedef struct {
+    Endgame *eg;
+    long long nodes;
+    long long table_hits;
+} EndgameThread;
+
+typedef struct {
+    int cell;
+    int misses;     // Fleets where the shot misses, for ordering
+    int certain;    // Sinks a ship in every fleet
+} EndgameShot;
+
+static int compare_endgame_shots(const void *a, const void *b) {
+    const EndgameShot *p = (const EndgameShot*)a, *q = (const EndgameShot*)b;
+    if (p->certain != q->certain) return q->certain - p->certain;
+    if (p->misses != q->misses) return p->misses - q->misses;
+    return p->cell - q->cell;
+}
+
+// Shots worth trying: each one either sinks a ship for sure or splits the
+// fleets. Returns the count written to shots.
+static int endgame_shots(Endgame *eg, const long *worlds, long n, const Bits256 *shots, EndgameShot *out) {
+    int cells = eg->cells;
+    int *counts = (int*)calloc((size_t)cells * ENDGAME_OUTCOMES, sizeof(int));
+    for (long i = 0; i < n; i++) {
+        const EndgameFleet *fleet = &eg->fleets[worlds[i]];
+        for (int j = 0; j < fleet->cell_count; j++) {
+            int c = fleet->cells[j];
+            if (!bits_test(shots, c)) counts[c * ENDGAME_OUTCOMES + endgame_outcome(eg, fleet, c, shots)]++;
+        }
+    }
+    
+    int count = 0;
+    for (int c = 0; c < cells; c++) {
+        if (bits_test(shots, c)) continue;
+        int *row = &counts[c * ENDGAME_OUTCOMES];
+        long covered = 0;
+        int classes = 0, sunk = 0;
+        for (int o = 1; o < ENDGAME_OUTCOMES; o++) {
+            covered += row[o];
+            if (row[o]) classes++;
+            if (o >= 6) sunk += row[o];
+        }
+        if (covered < n) classes++;
+        if (covered == 0 || (classes == 1 && sunk < n)) continue;  // Learns and sinks nothing
+        out[count].cell = c;
+        out[count].misses = (int)(n - covered);
+        out[count].certain = sunk == n;
+        count++;
+    }
+    free(counts);
+    qsort(out, count, sizeof(EndgameShot), compare_endgame_shots);
+    return count;
+}
+
+static double endgame_solve(EndgameThread *th, const long *worlds, long n, Bits256 *shots, int remaining);
+
+static int compare_counts_desc(const void *a, const void *b) {
+    return *(const int*)b - *(const int*)a;
+}
+
+static int compare_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t*)a, y = *(const uint64_t*)b;
+    return (x > y) - (x < y);
+}
+
+// Sum over k of 1 - (best head counts the first k shots can cover) / total,
+// for a search tree with the given branching
+static double tree_bound(int *counts, int cells, long long total, long long branches, int remaining) {
+    qsort(counts, cells, sizeof(int), compare_counts_desc);
+    double bound = 0;
+    long long top = 0, width = 1;
+    int used = 0;
+    for (long long k = 0; ; k++) {
+        long long sunk = top < k * total ? top : k * total;
+        if (sunk >= (long long)remaining * total) break;
+        bound += 1 - (double)sunk / ((double)remaining * total);
+        for (long long w = 0; w < width && used < cells; w++) top += counts[used++];
+        if (width < SMALL_BOARD_SIZE * SMALL_BOARD_SIZE) width *= branches;
+    }
+    return bound;
+}
+
+// Bound from telling the shooter where every afloat ship but ship k is:
+// those take one shot each, and ship k is a lone ship search within each
+// group of fleets that agree on the others
+static double hidden_ship_bound(Endgame *eg, const long *worlds, long n, const Bits256 *shots,
+                                int remaining, int k, uint64_t *keys) {
+    for (long i = 0; i < n; i++) {
+        const EndgameFleet *fleet = &eg->fleets[worlds[i]];
+        if (bits_test(shots, fleet->heads[k])) return 0;  // Sunk in some fleet
+        uint64_t others = 0;
+        for (int j = 0; j < eg->ship_count; j++) {
+            if (j != k && !bits_test(shots, fleet->heads[j])) others ^= eg->placement_keys[fleet->placements[j]];
+        }
+        // Group key above, head cell of ship k in the low byte
+        keys[i] = (others & ~(uint64_t)0xFF) | fleet->heads[k];
+    }
+    qsort(keys, n, sizeof(uint64_t), compare_u64);
+    
+    long long branches = get_ship_length(eg->types[k]) > 1 ? 2 : 1;  // Miss, or a hit on it
+    int counts[SMALL_BOARD_SIZE * SMALL_BOARD_SIZE];
+    double bound = 0;
+    for (long i = 0; i < n; ) {
+        long group = i;
+        int cells = 0;
+        while (i < n && (keys[i] >> 8) == (keys[group] >> 8)) {
+            long run = i;
+            while (i < n && keys[i] == keys[run]) i++;
+            counts[cells++] = (int)(i - run);
+        }
+        bound += (double)(i - group) / n * tree_bound(counts, cells, i - group, branches, 1);
+    }
+    return remaining - 1 + bound;
+}
+
+// Lower bound on the expected shots. A policy is a tree of shots, and with
+// B outcomes that can follow a shot its first k shots are at most
+// 1 + B + ... + B^(k-1) nodes on as many cells, so the ships sunk by then
+// are at most k and at most the head counts of the best such cells. The
+// game is still on after k shots at least as often as 1 - sunk / remaining,
+// and the expected shots are the sum of that over k. This is exact for a
+// lone one cell ship; with more ships afloat the hidden ship bounds are
+// usually the tighter ones.
+static double endgame_bound(Endgame *eg, const long *worlds, long n, const Bits256 *shots, int remaining) {
+    if (remaining == 0) return 0;
+    if (n == 1) return remaining;
+    
+    int heads[SMALL_BOARD_SIZE * SMALL_BOARD_SIZE] = {0};
+    int hit_types = 0, sunk_types = 0;
+    for (long i = 0; i < n; i++) {
+        const EndgameFleet *fleet = &eg->fleets[worlds[i]];
+        for (int k = 0; k < eg->ship_count; k++) {
+            if (bits_test(shots, fleet->heads[k])) continue;
+            heads[fleet->heads[k]]++;
+            int t = type_index(eg->types[k]);
+            sunk_types |= 1 << t;
+            if (get_ship_length(eg->types[k]) > 1) hit_types |= 1 << t;
+        }
+    }
+    int counts[SMALL_BOARD_SIZE * SMALL_BOARD_SIZE], cells = 0, most = 0;
+    for (int c = 0; c < eg->cells; c++) {
+        if (heads[c]) counts[cells++] = heads[c];
+        if (heads[c] > most) most = heads[c];
+    }
+    long long branches = 1 + __builtin_popcount(hit_types) + (remaining > 1 ? __builtin_popcount(sunk_types) : 0);
+    double bound = tree_bound(counts, cells, n, branches, remaining);
+    double floor = remaining + 1 - (double)most / n;
+    if (floor > bound) bound = floor;
+    
+    if (remaining > 1) {
+        uint64_t *keys = (uint64_t*)malloc(n * sizeof(uint64_t));
+        for (int k = 0; k < eg->ship_count; k++) {
+            double hidden = hidden_ship_bound(eg, worlds, n, shots, remaining, k, keys);
+            if (hidden > bound) bound = hidden;
+        }
+        free(keys);
+    }
+    return bound;
+}
+
+// Expected shots after firing at cell, or a lower bound of at least bound
+// when the shot cannot beat it
+static double endgame_try(EndgameThread *th, const long *worlds, long n, Bits256 *shots,
+                          int remaining, int cell, double bound) {
+    Endgame *eg = th->eg;
+    
+    // Split the fleets by outcome
+    long sizes[ENDGAME_OUTCOMES] = {0}, starts[ENDGAME_OUTCOMES];
+    unsigned char *outcomes = (unsigned char*)malloc(n);
+    for (long i = 0; i < n; i++) {
+        outcomes[i] = (unsigned char)endgame_outcome(eg, &eg->fleets[worlds[i]], cell, shots);
+        sizes[outcomes[i]]++;
+    }
+    long *split = (long*)malloc(n * sizeof(long));
+    for (int o = 0, at = 0; o < ENDGAME_OUTCOMES; at += sizes[o], o++) starts[o] = at;
+    long fill[ENDGAME_OUTCOMES];
+    memcpy(fill, starts, sizeof(fill));
+    for (long i = 0; i < n; i++) {
+        split[fill[outcomes[i]]++] = worlds[i];
+    }
+    free(outcomes);
+    
+    // Bound every outcome first, then replace the bounds by exact values
+    // for as long as the shot can still beat bound
+    bits_set(shots, cell);
+    double value = 1, bounds[ENDGAME_OUTCOMES];
+    for (int o = 0; o < ENDGAME_OUTCOMES; o++) {
+        if (sizes[o] == 0) continue;
+        bounds[o] = endgame_bound(eg, split + starts[o], sizes[o], shots, remaining - (o >= 6));
+        value += (double)sizes[o] / n * bounds[o];
+    }
+    for (int o = 0; o < ENDGAME_OUTCOMES && value < bound; o++) {
+        if (sizes[o] == 0) continue;
+        double child = endgame_solve(th, split + starts[o], sizes[o], shots, remaining - (o >= 6));
+        value += (double)sizes[o] / n * (child - bounds[o]);
+    }
+    shots->w[cell >> 6] &= ~((uint64_t)1 << (cell & 63));
+    free(split);
+    return value;
+}
+
+static double endgame_solve(EndgameThread *th, const long *worlds, long n, Bits256 *shots, int remaining) {
+    if (remaining == 0) return 0;
+    if (n == 1) return remaining;  // Fleet known: one shot per head
+    
+    // Sunk ships and shots on cells no afloat ship may cover read as water
+    // from now on and do not tell states apart
+    Endgame *eg = th->eg;
+    Bits256 afloat;
+    memset(&afloat, 0, sizeof(afloat));
+    uint64_t fleets_key = 0, shots_key = 0;
+    for (long i = 0; i < n; i++) {
+        const EndgameFleet *fleet = &eg->fleets[worlds[i]];
+        uint64_t fleet_key = 0;
+        for (int k = 0; k < eg->ship_count; k++) {
+            if (!bits_test(shots, fleet->heads[k])) fleet_key ^= eg->placement_keys[fleet->placements[k]];
+        }
+        fleets_key += mix64(fleet_key);
+        for (int j = 0; j < fleet->cell_count; j++) {
+            if (!bits_test(shots, fleet->heads[(fleet->codes[j] & 0x7F) - 1])) bits_set(&afloat, fleet->cells[j]);
+        }
+    }
+    for (int w = 0; w < 4; w++) {
+        uint64_t word = afloat.w[w] & shots->w[w];
+        while (word) {
+            shots_key ^= eg->cell_keys[w * 64 + __builtin_ctzll(word)];
+            word &= word - 1;
+        }
+    }
+    uint64_t key = fleets_key ^ mix64(shots_key);
+    double value;
+    if (endgame_probe(eg, key, &value)) {
+        th->table_hits++;
+        return value;
+    }
+    if (atomic_load_explicit(&eg->timed_out, memory_order_relaxed)) return remaining;
+    if ((++th->nodes & 1023) == 0) {
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        if (now.tv_sec > eg->deadline.tv_sec ||
+            (now.tv_sec == eg->deadline.tv_sec && now.tv_nsec >= eg->deadline.tv_nsec)) {
+            atomic_store(&eg->timed_out, 1);
+            return remaining;
+        }
+    }
+    
+    EndgameShot *candidates = (EndgameShot*)malloc(eg->cells * sizeof(EndgameShot));
+    int count = endgame_shots(eg, worlds, n, shots, candidates);
+    double best = 1e300;
+    double floor = endgame_bound(eg, worlds, n, shots, remaining);
+    for (int i = 0; i < count && best > floor; i++) {
+        double v = endgame_try(th, worlds, n, shots, remaining, candidates[i].cell, best);
+        if (v < best) best = v;
+    }
+    free(candidates);
+    
+    if (!atomic_load_explicit(&eg->timed_out, memory_order_relaxed)) endgame_store(eg, key, best);
+    return best;
+}
+
+// Root: threads take candidate first shots in turn and share the best value
+typedef struct {
+    EndgameThread thread;
+    long *worlds;
+    EndgameShot *candidates;
+    int count;
+    _Atomic int *next;
+    double best;
+    int best_cell;
+} EndgameTask;
+
+static void* endgame_worker(void *arg) {
+    EndgameTask *task = (EndgameTask*)arg;
+    Endgame *eg = task->thread.eg;
+    Bits256 shots = eg->shots;
+    
+    task->best = 1e300;
+    task->best_cell = -1;
+    for (;;) {
+        int i = atomic_fetch_add(task->next, 1);
+        if (i >= task->count) break;
+        
+        uint64_t bits = atomic_load(&eg->best);
+        double bound;
+        memcpy(&bound, &bits, sizeof(double));
+        double v = endgame_try(&task->thread, task->worlds, eg->fleet_count, &shots,
+                               eg->ship_count, task->candidates[i].cell, bound);
+        if (v < task->best || (v == task->best && task->candidates[i].cell < task->best_cell)) {
+            task->best = v;
+            task->best_cell = task->candidates[i].cell;
+        }
+        
+        // Lower the shared bound
+        memcpy(&bits, &v, sizeof(double));
+        uint64_t current = atomic_load(&eg->best);
+        for (;;) {
+            double shared;
+            memcpy(&shared, &current, sizeof(double));
+            if (v >= shared || atomic_compare_exchange_weak(&eg->best, &current, bits)) break;
+        }
+    }
+    return NULL;
+}
+
+// Value of the endgame and the first shot of an optimal policy (cell index,
+// -1 when nothing is afloat). Returns FEASIBLE_UNKNOWN if the budget ran out.
+int solve_endgame(Endgame *eg, int thread_count, long budget_ms, double *value, int *best_cell,
+                  long long *nodes, long long *table_hits) {
+    *value = 0;
+    *best_cell = -1;
+    *nodes = *table_hits = 0;
+    if (eg->ship_count == 0 || eg->fleet_count == 0) return FEASIBLE_YES;
+    
+    clock_gettime(CLOCK_MONOTONIC, &eg->deadline);
+    eg->deadline.tv_sec += budget_ms / 1000;
+    eg->deadline.tv_nsec += (budget_ms % 1000) * 1000000L;
+    if (eg->deadline.tv_nsec >= 1000000000L) {
+        eg->deadline.tv_sec++;
+        eg->deadline.tv_nsec -= 1000000000L;
+    }
+    atomic_store(&eg->timed_out, 0);
+    
+    long *worlds = (long*)malloc(eg->fleet_count * sizeof(long));
+    for (long w = 0; w < eg->fleet_count; w++) worlds[w] = w;
+    EndgameShot *candidates = (EndgameShot*)malloc(eg->cells * sizeof(EndgameShot));
+    int count = endgame_shots(eg, worlds, eg->fleet_count, &eg->shots, candidates);
+    
+    double infinity = 1e300;
+    uint64_t bits;
+    memcpy(&bits, &infinity, sizeof(double));
+    atomic_store(&eg->best, bits);
+    _Atomic int next = 0;
+    
+    pthread_t *threads = (pthread_t*)malloc(thread_count * sizeof(pthread_t));
+    EndgameTask *tasks = (EndgameTask*)calloc(thread_count, sizeof(EndgameTask));
+    for (int t = 0; t < thread_count; t++) {
+        tasks[t].thread.eg = eg;
+        tasks[t].worlds = worlds;
+        tasks[t].candidates = candidates;
+        tasks[t].count = count;
+        tasks[t].next = &next;
+        pthread_create(&threads[t], NULL, endgame_worker, &tasks[t]);
+    }
+    
+    double best = infinity;
+    for (int t = 0; t < thread_count; t++) {
+        pthread_join(threads[t], NULL);
+        *nodes += tasks[t].thread.nodes;
+        *table_hits += tasks[t].thread.table_hits;
+        if (tasks[t].best < best || (tasks[t].best == best && tasks[t].best_cell < *best_cell)) {
+            best = tasks[t].best;
+            *best_cell = tasks[t].best_cell;
+        }
+    }
+    
+    free(threads);
+    free(tasks);
+    free(worlds);
+    free(candidates);
+    *value = best;
+    return atomic_load(&eg->timed_out) ? FEASIBLE_UNKNOWN : FEASIBLE_YES;
+}
+
+// Read one game from stdin up to EOF like --estimate, then solve the
+// endgame of the player on turn
+int run_endgame(int thread_count, long budget_ms) {
+    if (thread_count < 1) {
+        thread_count = (int)sysconf(_SC_NPROCESSORS_ONLN);
+        if (thread_count < 1) thread_count = 1;
+    }
+    
+    int J, N, M;
+    if (scanf("%d %d %d", &J, &N, &M) != 3) return 1;
+    
+    Match *match = create_match(0, N, M, MATCH_SILENT);
+    char type, orientation;
+    int x, y;
+    while (match->phase == PHASE_PLACEMENT &&
+           scanf(" %c %c %d %d", &type, &orientation, &x, &y) == 4) {
+        if (!match_place(match, match_next_placer(match), type, orientation, x, y)) {
+            printf("Eroare: navă invalidă. Încercați din nou.\n");
+        }
+    }
+    while (match->phase == PHASE_ATTACK && scanf("%d %d", &x, &y) == 2) {
+        match_attack(match, match->current_player, x, y);
+    }
+    if (match->phase != PHASE_ATTACK) {
+        printf("Jocul nu este în desfășurare.\n");
+        destroy_match(match);
+        return 1;
+    }
+    
+    Endgame eg;
+    int ok = init_endgame(&eg, match);
+    int shooter = match->current_player;
+    destroy_match(match);
+    if (!ok) {
+        printf("Eroare: finalul este prea mare pentru rezolvarea exactă.\n");
+        free_endgame(&eg);
+        return 1;
+    }
+    
+    printf("Jucătorul %d: %d nave rămase, %ld flote posibile\n", shooter, eg.ship_count, eg.fleet_count);
+    fflush(stdout);
+    
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    int cell;
+    long long nodes, table_hits;
+    double value;
+    int result = solve_endgame(&eg, thread_count, budget_ms, &value, &cell, &nodes, &table_hits);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    
+    if (result == FEASIBLE_UNKNOWN) {
+        printf("Nedeterminat: bugetul de timp s-a epuizat.\n");
+    } else {
+        printf("Lovituri așteptate până la final: %.6f", value);
+        if (cell >= 0) printf(", prima lovitură %d %d", cell / eg.M + 1, cell % eg.M + 1);
+        printf("\n");
+    }
+    printf("%lld noduri, %lld din tabelă, %d fire, %.3f s\n", nodes, table_hits, thread_count, seconds);
+    free_endgame(&eg);
+    return result == FEASIBLE_UNKNOWN ? 2 : 0;
+}
+
+int main(int argc, char *argv[]) {
+    // Salvo mode: every turn fires one shot per surviving ship
+    int salvo_mode = (argc > 1 && strcmp(argv[1], "--salvo") == 0);
+    
+    // Spectator mode: show the changed rows of the attacked board after every shot
+    int spectate_mode = (argc > 1 && strcmp(argv[1], "--spectate") == 0);
+    
+    // Server mode: host many matches at once, one worker per shard
+    if (argc > 1 && strcmp(argv[1], "--server") == 0) {
+        return run_server(argc > 2 ? atoi(argv[2]) : 0);
+    }
+    
+    // Archive modes: text games to the compressed format and back
+    if (argc > 1 && strcmp(argv[1], "--archive") == 0) {
+        return archive_games(stdin, stdout) >= 0 ? 0 : 1;
+    }
+    if (argc > 1 && strcmp(argv[1], "--unarchive") == 0) {
+        return unarchive_games(stdin, stdout, argc > 2 ? atol(argv[2]) : 0,
+                               argc > 3 ? atol(argv[3]) : -1) >= 0 ? 0 : 1;
+    }
+    
+    // Replay mode: a game of the input after the given shots
+    if (argc > 2 && strcmp(argv[1], "--replay") == 0) {
+        return run_replay(atoi(argv[2]), argv + 3, argc - 3);
+    }
+    
+    // Free-for-all mode: P players, every shot names its target
+    if (argc > 1 && strcmp(argv[1], "--lobby") == 0) {
+        return run_lobby();
+    }
+    if (argc > 4 && strcmp(argv[1], "--lobby-bench") == 0) {
+        return run_lobby_bench(atoi(argv[2]), atoi(argv[3]), atoi(argv[4]),
+                               argc > 5 ? atoi(argv[5]) : 0, argc > 6 ? atoi(argv[6]) : 1);
+    }
+    
+    // Bot tournament: --tournament N M seeds [threads] [seed]
+    if (argc > 4 && strcmp(argv[1], "--tournament") == 0) {
+        return run_tournament(atoi(argv[2]), atoi(argv[3]), atoi(argv[4]),
+                              argc > 5 ? atoi(argv[5]) : 0, argc > 6 ? strtoull(argv[6], NULL, 10) : 1);
+    }
+    
+    // Feasibility mode: does the fleet fit, and how
+    if (argc > 1 && strcmp(argv[1], "--feasible") == 0) {
+        return run_feasible(argc, argv);
+    }
+    if (argc > 1 && strcmp(argv[1], "--feasible-bench") == 0) {
+        return run_feasible_bench(argc > 2 ? atol(argv[2]) : 2000);
+    }
+    
+    // Statistics mode: aggregate every game of the input, --stats [threads] [cache_mb]
+    if (argc > 1 && strcmp(argv[1], "--stats") == 0) {
+        return run_stats(stdin, stdout, argc > 2 ? atoi(argv[2]) : 0, argc > 3 ? atol(argv[3]) : 64);
+    }
+    
+    // Endgame mode: exact expected shots to finish for the player on turn
+    if (argc > 1 && strcmp(argv[1], "--endgame") == 0) {
+        return run_endgame(argc > 2 ? atoi(argv[2]) : 0, argc > 3 ? atol(argv[3]) : 60000);
+    }
+    
+    // Estimator mode: win probabilities for a game read up to EOF
+    if (argc > 1 && strcmp(argv[1], "--estimate") == 0) {
+        return run_estimator(argc > 2 ? atoll(argv[2]) : 100000, argc > 3 ? atoi(argv[3]) : 0);
+    }
+    
+    // Event mode: the engine publishes hits and wins to a ring and a
+    // separate thread prints them
+    EventRing *events = NULL;
+    pthread_t event_thread;
+    if (argc > 1 && strcmp(argv[1], "--events") == 0) {
+        events = create_event_ring(4096);
+        pthread_create(&event_thread, NULL, render_events, events);
+    }
+    
+    // Feed mode: mirror the boards into shared memory for spectator readers
+    Feed *feed = NULL;
+    if (argc > 2 && strcmp(argv[1], "--feed") == 0) {
+        feed = open_feed(argv[2]);
+        if (!feed) {
+            printf("Eroare: segmentul de memorie partajată nu poate fi creat.\n");
+            return 1;
+        }
+    }
+    
+    int J;
+    scanf("%d", &J);
+    
+    for (int game = 0; game < J; game++) {
+        int N, M;
+        scanf("%d %d", &N, &M);
+        
+        // The renderer works on the general engine's boards
+        int flags = (salvo_mode ? MATCH_SALVO : 0) | (spectate_mode ? MATCH_GENERAL : 0);
+        Match *match = create_match(game, N, M, flags);
+        if (events) {
+            match_set_events(match, events);
+        }
+        if (feed) {
+            feed_new_game(feed, match, game + 1, N, M);
+        }
+        
+        // Placement phase: player 1 places the whole fleet, then player 2
+        while (match->phase == PHASE_PLACEMENT) {
+            char type, orientation;
+            int x, y;
+            scanf(" %c %c %d %d", &type, &orientation, &x, &y);
+            
+            int player = match_next_placer(match);
+            if (!match_place(match, player, type, orientation, x, y)) {
+                printf("Eroare: navă invalidă. Încercați din nou.\n");
+            } else if (feed) {
+                feed_placement(feed, match, player, type, orientation, x, y);
+            }
+        }
+        
+        // Print both boards
+        match_print_board(match, 1);
+        printf("\n");
+        match_print_board(match, 2);
+        
+        if (spectate_mode) {
+            attach_view(match->players[0]);
+            attach_view(match->players[1]);
+        }
+        
+        // Attack phase
+        while (match->phase == PHASE_ATTACK) {
+            int attack_x, attack_y;
+            scanf("%d %d", &attack_x, &attack_y);
+            
+            int target = 3 - match->current_player;
+            match_attack(match, match->current_player, attack_x, attack_y);
+            if (feed) {
+                feed_attack(feed, match, target, attack_x, attack_y);
+            }
+            if (spectate_mode) {
+                char title[32];
+                snprintf(title, sizeof(title), "Tabla %d", target);
+                emit_view(match->players[target - 1], title, 0);
+            }
+        }
+        if (events) {
+            // The consumer prints the win; keep it before anything printed here
+            drain_event_ring(events);
+        } else {
+            printf("Jucătorul %d a câștigat!\n", match->winner);
+        }
+        
+        // Clean up
+        destroy_match(match);
+        
+        // Add newline between games if not the last game
+        if (game < J - 1) {
+            printf("\n");
+        }
+    }
+    
+    if (events) {
+        atomic_store(&events->closed, 1);
+        pthread_join(event_thread, NULL);
+        destroy_event_ring(events);
     }
+    close_feed(feed);
     
     return 0;
 }
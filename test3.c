@@ -38,11 +38,11 @@ int calculeaza_nave_per_tip(int N, int M, char tip);
 // Calculează numărul de nave pentru un tip dat
 int calculeaza_nave_per_tip(int N, int M, char tip) {
     switch (tip) {
-        case 'S': return (N * M) / 70;  // Shinano
-        case 'Y': return (N * M) / 55;  // Yamato
-        case 'B': return (N * M) / 40;  // Belfast
-        case 'L': return (N * M) / 30;  // Laffey
-        case 'A': return (N * M) / 20;  // Albacore
+        case 'S': return (int)(((long long)N * M) / 70);  // Shinano
+        case 'Y': return (int)(((long long)N * M) / 55);  // Yamato
+        case 'B': return (int)(((long long)N * M) / 40);  // Belfast
+        case 'L': return (int)(((long long)N * M) / 30);  // Laffey
+        case 'A': return (int)(((long long)N * M) / 20);  // Albacore
         default: return 0;
     }
 }